@@ -0,0 +1 @@
+../src/db/dbCodec.h
\ No newline at end of file
@@ -0,0 +1 @@
+../src/db/dbKernel.h
\ No newline at end of file
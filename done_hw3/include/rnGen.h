@@ -0,0 +1 @@
+../src/util/rnGen.h
\ No newline at end of file
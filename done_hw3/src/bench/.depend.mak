@@ -0,0 +1,2 @@
+dbBench.o: dbBench.cpp ../../include/util.h ../../include/rnGen.h \
+ ../../include/dbTable.h ../../include/dbKernel.h ../../include/dbCodec.h
@@ -0,0 +1,305 @@
+/****************************************************************************
+  FileName     [ dbBench.cpp ]
+  PackageName  [ bench ]
+  Synopsis     [ Benchmark of the db package on synthetic csv files ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2015-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "util.h"
+#include "rnGen.h"
+#include "dbTable.h"
+
+using namespace std;
+
+class CmdParser;
+CmdParser* cmdMgr = 0; // for linking purpose
+
+// The settings of a run; see usage()
+struct BenchConfig
+{
+   BenchConfig() : _nRows(1000000), _nCols(4), _nullRatio(0.05),
+      _min(-1000000), _max(1000000), _card(0), _seed(0), _reps(3),
+      _nThreads(1), _csv("dbBench.csv"), _keep(false) {}
+
+   int       _nRows;
+   int       _nCols;
+   double    _nullRatio;
+   int       _min;         // the range of the values
+   int       _max;
+   int       _card;        // #distinct values per column; 0 for any
+   int       _seed;
+   int       _reps;
+   int       _nThreads;    // for DBRead
+   string    _csv;
+   bool      _keep;        // keep the csv file afterwards
+};
+
+// The times of one benchmark in all the repetitions
+struct BenchResult
+{
+   BenchResult(const string& name) : _name(name) {}
+
+   string            _name;
+   vector<double>    _ms;
+};
+
+// A friend of DBTable, to drop its cached statistics between the timed runs
+class DBBench
+{
+public:
+   // forget the cached aggregates and zone maps of all the columns, so
+   // that the next query recomputes them from the cells
+   static void dropStats(DBTable& t) {
+      for (size_t c = 0, n = t._cols.size(); c < n; ++c)
+         t._cols[c].touch(0, t._cols[c].size());
+   }
+};
+
+/*****************************************/
+/*          Static Functions             */
+/*****************************************/
+static void
+usage()
+{
+   cerr << "Usage: dbBench [-rows (int n)] [-cols (int n)] [-nulls (double "
+        << "ratio)]\n"
+        << "               [-min (int lo)] [-max (int hi)] [-card (int n)] "
+        << "[-seed (int s)]\n"
+        << "               [-reps (int n)] [-threads (int n)] [-csv (string "
+        << "file)] [-keep]\n"
+        << "The csv file is generated and then read by every benchmark; the "
+        << "results are\nprinted to stdout in JSON." << endl;
+}
+
+static double
+wallClock()
+{
+   return chrono::duration<double>(
+      chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// A uniform random number in [0, n), n <= 2^32. RandomNumGen only takes
+// an int range (and may return the range itself), so larger ranges are
+// drawn in two halves of 16 bits.
+static uint64_t
+randomBelow(const RandomNumGen& rn, uint64_t n)
+{
+   if (n <= INT_MAX) return min(uint64_t(rn(int(n))), n - 1);
+   uint64_t hi = min(rn(1 << 16), 0xffff), lo = min(rn(1 << 16), 0xffff);
+   return ((hi << 16) | lo) % n;
+}
+
+// Write the csv file of the config; each column has its own pool of
+// 'card' values if the cardinality is bounded. Return #bytes written.
+static size_t
+generateCsv(const BenchConfig& cfg)
+{
+   RandomNumGen rn(cfg._seed);
+   uint64_t span = uint64_t(int64_t(cfg._max) - cfg._min) + 1;
+   size_t nullCut = size_t(cfg._nullRatio * 1000000 + 0.5);
+   vector<vector<int> > pools(cfg._nCols);
+   if (cfg._card)
+      for (int c = 0; c < cfg._nCols; ++c)
+         for (int i = 0; i < cfg._card; ++i)
+            pools[c].push_back(int(cfg._min + int64_t(randomBelow(rn, span))));
+
+   FILE* f = fopen(cfg._csv.c_str(), "w");
+   if (!f) return 0;
+   vector<char> line;
+   char cell[16];
+   size_t nBytes = 0;
+   for (int r = 0; r < cfg._nRows; ++r) {
+      line.clear();
+      for (int c = 0; c < cfg._nCols; ++c) {
+         if (c) line.push_back(',');
+         if (randomBelow(rn, 1000000) < nullCut) continue;
+         int d = cfg._card? pools[c][randomBelow(rn, cfg._card)]:
+                 int(cfg._min + int64_t(randomBelow(rn, span)));
+         line.insert(line.end(), cell, cell + sprintf(cell, "%d", d));
+      }
+      line.push_back('\n');
+      nBytes += fwrite(line.data(), 1, line.size(), f);
+   }
+   return fclose(f) == 0? nBytes: 0;
+}
+
+static bool
+readTable(const BenchConfig& cfg, DBTable& t)
+{
+   size_t nBytes;
+   t.reset();
+   return t.readCsv(cfg._csv, cfg._nThreads, nBytes);
+}
+
+static bool
+parseInt(int argc, char** argv, int& i, int& n, int lo)
+{
+   if (++i == argc || !myStr2Int(argv[i], n) || n < lo) {
+      cerr << "Error: illegal value for \"" << argv[i - 1] << "\"!!" << endl;
+      return false;
+   }
+   return true;
+}
+
+static bool
+parseArgs(int argc, char** argv, BenchConfig& cfg)
+{
+   for (int i = 1; i < argc; ++i) {
+      string opt = argv[i];
+      bool ok = true;
+      if (opt == "-rows") ok = parseInt(argc, argv, i, cfg._nRows, 1);
+      else if (opt == "-cols") ok = parseInt(argc, argv, i, cfg._nCols, 1);
+      else if (opt == "-min") ok = parseInt(argc, argv, i, cfg._min, INT_MIN);
+      else if (opt == "-max") ok = parseInt(argc, argv, i, cfg._max, INT_MIN);
+      else if (opt == "-card") ok = parseInt(argc, argv, i, cfg._card, 0);
+      else if (opt == "-seed") ok = parseInt(argc, argv, i, cfg._seed, 0);
+      else if (opt == "-reps") ok = parseInt(argc, argv, i, cfg._reps, 1);
+      else if (opt == "-threads")
+         ok = parseInt(argc, argv, i, cfg._nThreads, 1);
+      else if (opt == "-nulls") {
+         char* e = 0;
+         if (i + 1 < argc) cfg._nullRatio = strtod(argv[++i], &e);
+         if (!e || *e || !(cfg._nullRatio >= 0 && cfg._nullRatio <= 1)) {
+            cerr << "Error: illegal value for \"-nulls\"!!" << endl;
+            return false;
+         }
+      }
+      else if (opt == "-csv" && i + 1 < argc) cfg._csv = argv[++i];
+      else if (opt == "-keep") cfg._keep = true;
+      else {
+         usage();
+         return false;
+      }
+      if (!ok) return false;
+   }
+   // INT_MAX is the null cell
+   if (cfg._min > cfg._max || cfg._max == INT_MAX) {
+      cerr << "Error: illegal value range [" << cfg._min << ", " << cfg._max
+           << "]!!" << endl;
+      return false;
+   }
+   return true;
+}
+
+static double
+median(vector<double> v)
+{
+   std::sort(v.begin(), v.end());
+   size_t n = v.size();
+   return n % 2? v[n / 2]: (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+static void
+printJson(ostream& os, const BenchConfig& cfg, size_t nBytes,
+          const vector<BenchResult>& results)
+{
+   os << fixed << setprecision(3);
+   os << "{\n"
+      << "  \"build\": {\"compiler\": \"" << __VERSION__ << "\", "
+      << "\"optimized\": " << (dbOptimized()? "true": "false") << "},\n"
+      << "  \"config\": {\"rows\": " << cfg._nRows << ", \"cols\": "
+      << cfg._nCols << ", \"nulls\": " << cfg._nullRatio << ", \"min\": "
+      << cfg._min << ", \"max\": " << cfg._max << ", \"card\": " << cfg._card
+      << ", \"seed\": " << cfg._seed << ", \"reps\": " << cfg._reps
+      << ", \"threads\": " << cfg._nThreads << "},\n"
+      << "  \"csvBytes\": " << nBytes << ",\n"
+      << "  \"results\": [\n";
+   for (size_t i = 0; i < results.size(); ++i) {
+      const BenchResult& r = results[i];
+      double best = *min_element(r._ms.begin(), r._ms.end());
+      os << "    {\"name\": \"" << r._name << "\", \"ms\": [";
+      for (size_t j = 0; j < r._ms.size(); ++j)
+         os << (j? ", ": "") << r._ms[j];
+      os << "], \"minMs\": " << best << ", \"medianMs\": " << median(r._ms)
+         << ", \"rowsPerSec\": " << setprecision(0)
+         << (best > 0? cfg._nRows / (best / 1000): 0) << setprecision(3)
+         << "}" << (i + 1 < results.size()? ",": "") << "\n";
+   }
+   os << "  ]\n}" << endl;
+}
+
+/*****************************************/
+/*             Main Function             */
+/*****************************************/
+// The aggregates are over all the columns. DBRead already computes the zone
+// maps and the column aggregates, so they are dropped before every timed
+// aggregate: DBMAx/DBMIn rescan all the zones, DBSUm/DBAVerage run the
+// aggregate kernels over the whole column, and no aggregate gets a result
+// cached by another one.
+int
+main(int argc, char** argv)
+{
+   BenchConfig cfg;
+   if (!parseArgs(argc, argv, cfg)) return 1;
+   if (!dbOptimized())
+      cerr << "Warning: the db package was built without optimization; "
+           << "run \"make clean; make bench\" to time an optimized build!!"
+           << endl;
+
+   cerr << "Generating \"" << cfg._csv << "\"..." << endl;
+   size_t nBytes = generateCsv(cfg);
+   if (!nBytes) {
+      cerr << "Error: cannot write \"" << cfg._csv << "\"!!" << endl;
+      return 1;
+   }
+
+   typedef void (*AggFunc)(const DBTable&, size_t);
+   struct { const char* _name; AggFunc _f; } aggs[] = {
+      { "DBMAx", [](const DBTable& t, size_t c) { t.getMax(c); } },
+      { "DBMIn", [](const DBTable& t, size_t c) { t.getMin(c); } },
+      { "DBSUm", [](const DBTable& t, size_t c) {
+         bool allNull; t.getSum(c, allNull); } },
+      { "DBAVerage", [](const DBTable& t, size_t c) { t.getAve(c); } },
+      { "DBCount", [](const DBTable& t, size_t c) { t.getCount(c); } },
+      { "DBCount -Approx", [](const DBTable& t, size_t c) {
+         double relErr; t.getApproxCount(c, relErr); } }
+   };
+   const size_t nAggs = sizeof(aggs) / sizeof(aggs[0]);
+
+   vector<BenchResult> results;
+   results.push_back(BenchResult("DBRead"));
+   for (size_t a = 0; a < nAggs; ++a)
+      results.push_back(BenchResult(aggs[a]._name));
+   results.push_back(BenchResult("DBPrint -Table"));
+   results.push_back(BenchResult("DBSOrt 0"));
+
+   DBTable t;
+   ofstream devNull("/dev/null");
+   for (int rep = 0; rep < cfg._reps; ++rep) {
+      cerr << "Repetition #" << rep << "..." << endl;
+      size_t k = 0;
+      double tm = wallClock();
+      if (!readTable(cfg, t)) {
+         cerr << "Error: cannot read \"" << cfg._csv << "\"!!" << endl;
+         return 1;
+      }
+      results[k++]._ms.push_back((wallClock() - tm) * 1000);
+      for (size_t a = 0; a < nAggs; ++a) {
+         DBBench::dropStats(t);
+         tm = wallClock();
+         for (size_t c = 0, n = t.nCols(); c < n; ++c) aggs[a]._f(t, c);
+         results[k++]._ms.push_back((wallClock() - tm) * 1000);
+      }
+      tm = wallClock();
+      devNull << t;
+      devNull.flush();
+      results[k++]._ms.push_back((wallClock() - tm) * 1000);
+      DBSort s;
+      s.pushOrder(0);
+      tm = wallClock();
+      t.sort(s);
+      results[k++]._ms.push_back((wallClock() - tm) * 1000);
+   }
+
+   printJson(cout, cfg, nBytes, results);
+   if (!cfg._keep) remove(cfg._csv.c_str());
+   return 0;
+}
@@ -41,14 +41,17 @@ static void set_keypress(void)
 //----------------------------------------------------------------------
 //    Global funcitons
 //----------------------------------------------------------------------
+// The terminal mode is only switched for the keyboard; a dofile is read
+// without the 4 termios system calls per character.
 static char mygetc(istream& istr)
 {
    char ch;
-   set_keypress();
+   const bool kb = &istr == &cin;
+   if (kb) set_keypress();
    istr.unsetf(ios_base::skipws);
    istr >> ch;
    istr.setf(ios_base::skipws);
-   reset_keypress();
+   if (kb) reset_keypress();
    #ifdef TEST_ASC
    cout << left << setw(6) << int(ch);
    #endif // TEST_ASC
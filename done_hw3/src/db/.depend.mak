@@ -1,3 +1,20 @@
 dbCmd.o: dbCmd.cpp ../../include/util.h dbCmd.h ../../include/cmdParser.h \
- ../../include/cmdCharDef.h dbTable.h
-dbTable.o: dbTable.cpp dbTable.h ../../include/util.h
+ ../../include/cmdCharDef.h dbTable.h dbKernel.h dbCodec.h dbReader.h \
+ dbHash.h dbFilter.h
+dbCodec.o: dbCodec.cpp dbTable.h dbKernel.h dbCodec.h dbHash.h
+dbExtSort.o: dbExtSort.cpp dbReader.h dbKernel.h dbFormat.h
+dbFilter.o: dbFilter.cpp dbTable.h dbKernel.h dbCodec.h dbFilter.h
+dbFormat.o: dbFormat.cpp dbFormat.h
+dbGroup.o: dbGroup.cpp dbTable.h dbKernel.h dbCodec.h dbHash.h dbThread.h
+dbIndex.o: dbIndex.cpp dbTable.h dbKernel.h dbCodec.h dbHash.h
+dbJoin.o: dbJoin.cpp dbTable.h dbKernel.h dbCodec.h dbHash.h
+dbKernel.o: dbKernel.cpp dbKernel.h
+dbQuantile.o: dbQuantile.cpp dbTable.h dbKernel.h dbCodec.h
+dbReader.o: dbReader.cpp dbTable.h dbKernel.h dbCodec.h dbReader.h \
+ dbThread.h
+dbScan.o: dbScan.cpp dbReader.h dbKernel.h dbHash.h
+dbSnapshot.o: dbSnapshot.cpp dbTable.h dbKernel.h dbCodec.h dbReader.h \
+ dbThread.h
+dbSort.o: dbSort.cpp dbTable.h dbKernel.h dbCodec.h dbThread.h
+dbTable.o: dbTable.cpp dbTable.h dbKernel.h dbCodec.h dbHash.h dbThread.h \
+ dbFormat.h ../../include/util.h
@@ -1,4 +1,10 @@
-db.d: ../../include/dbTable.h 
+db.d: ../../include/dbTable.h ../../include/dbKernel.h ../../include/dbCodec.h 
 ../../include/dbTable.h: dbTable.h
 	@rm -f ../../include/dbTable.h
 	@ln -fs ../src/db/dbTable.h ../../include/dbTable.h
+../../include/dbKernel.h: dbKernel.h
+	@rm -f ../../include/dbKernel.h
+	@ln -fs ../src/db/dbKernel.h ../../include/dbKernel.h
+../../include/dbCodec.h: dbCodec.h
+	@rm -f ../../include/dbCodec.h
+	@ln -fs ../src/db/dbCodec.h ../../include/dbCodec.h
@@ -6,16 +6,27 @@
   Copyright    [ Copyleft(c) 2015-present LaDs(III), GIEE, NTU, Taiwan ]
 ****************************************************************************/
 #include <iostream>
+#include <cstdlib>
 #include <iomanip>
 #include <cassert>
 #include <climits>
+#include <chrono>
+#include <map>
 #include "util.h"
 #include "dbCmd.h"
 #include "dbTable.h"
+#include "dbReader.h"
+#include "dbHash.h"
+#include "dbFilter.h"
 
 // Global variable
 DBTable dbtbl;
 
+// The table catalog. The current table is always 'dbtbl', on which all the
+// single-table commands work; the others are kept here by name (DBUse).
+static map<string, DBTable> dbCatalog;
+static string dbCurName = "main";
+
 // Static functions
 static bool checkColIdx(const string& token, int& c)
 {
@@ -35,6 +46,107 @@ static bool checkColIdx(const string& token, int& c)
    return true;
 }
 
+// Wall-clock time in seconds, for reporting the run time of a command
+static double wallClock()
+{
+   return chrono::duration<double>(
+          chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Report the size and throughput of a table load/save taking 't' seconds
+static void printIOStat(size_t nRows, size_t nBytes, double t)
+{
+   ios_base::fmtflags origFlags = cout.flags();
+   streamsize origPrec = cout.precision();
+   cout << "(" << nRows << " rows, " << nBytes << " bytes in " << fixed
+        << setprecision(3) << t << " s; " << setprecision(1);
+   if (t > 0) cout << nBytes / t / (1 << 20) << " MB/s)" << endl;
+   else cout << "too fast to measure)" << endl;
+   cout.flags(origFlags);
+   cout.precision(origPrec);
+}
+
+// Aggregates that can be applied to a subset of rows
+enum DBAggOp
+{
+   DB_AGG_NONE,
+   DB_AGG_SUM,
+   DB_AGG_MAX,
+   DB_AGG_MIN,
+   DB_AGG_AVE,
+   DB_AGG_COUNT
+};
+
+static DBAggOp parseAggOp(const string& token)
+{
+   if (myStrNCmp("-Sum", token, 2) == 0) return DB_AGG_SUM;
+   if (myStrNCmp("-Max", token, 3) == 0) return DB_AGG_MAX;
+   if (myStrNCmp("-MIn", token, 3) == 0) return DB_AGG_MIN;
+   if (myStrNCmp("-Ave", token, 2) == 0) return DB_AGG_AVE;
+   if (myStrNCmp("-Count", token, 2) == 0) return DB_AGG_COUNT;
+   return DB_AGG_NONE;
+}
+
+// Print aggregate 'op' of 'a' (or 'nDistinct' for DB_AGG_COUNT) the same
+// way as DBSUm/DBMAx/DBMIn/DBAVerage/DBCount; nan if there is no data, as
+// for the whole-column aggregates.
+static void printAgg(ostream& os, DBAggOp op, const DBColAgg& a,
+                     size_t nDistinct)
+{
+   if (op == DB_AGG_COUNT) { os << nDistinct; return; }
+   if (!a._count) { os << float(NAN); return; }
+   ios_base::fmtflags origFlags = os.flags();
+   streamsize origPrec = os.precision();
+   switch (op) {
+      case DB_AGG_SUM: os << a._sum; break;
+      case DB_AGG_MAX: os << float(a._max); break;
+      case DB_AGG_MIN: os << float(a._min); break;
+      default:         os << fixed << setprecision(2)
+                          << float(double(a._sum) / a._count); break;
+   }
+   os.flags(origFlags);
+   os.precision(origPrec);
+}
+
+static const char* aggOpName(DBAggOp op)
+{
+   static const char* names[] = {
+      "", "sum", "max data", "min data", "average", "distinct count" };
+   return names[op];
+}
+
+// The table named 'name' (the current one or in the catalog), or 0
+static DBTable* findTable(const string& name)
+{
+   if (name == dbCurName) return &dbtbl;
+   map<string, DBTable>::iterator it = dbCatalog.find(name);
+   return it == dbCatalog.end()? 0: &it->second;
+}
+
+// Parse "<table>.<(int colIdx)>" into a non-empty table and its column
+static bool checkTableCol(const string& token, DBTable*& t, int& c)
+{
+   size_t dot = token.rfind('.');
+   if (dot == string::npos || dot == 0) {
+      cerr << "Error: " << token << " is not in <table>.<col> form!!\n";
+      return false;
+   }
+   string name = token.substr(0, dot), col = token.substr(dot + 1);
+   if (!(t = findTable(name)) || !*t) {
+      cerr << "Error: Table \"" << name << "\" does not exist or is empty!!\n";
+      return false;
+   }
+   if (!myStr2Int(col, c)) {
+      cerr << "Error: " << col << " is not a number!!\n";
+      return false;
+   }
+   if (c < 0 || c >= int(t->nCols())) {
+      cerr << "Error: Column index " << c << " is out of range!!\n";
+      return false;
+   }
+   return true;
+}
+
 static bool checkRowIdx(const string& token, int& c)
 {
    if (!dbtbl) {
@@ -53,19 +165,46 @@ static bool checkRowIdx(const string& token, int& c)
    return true;
 }
 
+// The size of -MemLimit: in MB, or in KB with a trailing 'K' (e.g. "64K")
+static bool str2MemLimit(const string& token, size_t& bytes)
+{
+   string str = token;
+   size_t shift = 20;
+   if (str.size() > 1 && (str.back() == 'K' || str.back() == 'k')) {
+      str.pop_back();
+      shift = 10;
+   }
+   int n;
+   if (!myStr2Int(str, n) || n <= 0) return false;
+   bytes = size_t(n) << shift;
+   return true;
+}
+
 bool
 initDbCmd()
 {
    if (!(cmdMgr->regCmd("DBAppend", 4, new DBAppendCmd) &&
       cmdMgr->regCmd("DBAve", 4, new DBAveCmd) &&
+      cmdMgr->regCmd("DBCOMpact", 5, new DBCompactCmd) &&
       cmdMgr->regCmd("DBCount", 3, new DBCountCmd) &&
       cmdMgr->regCmd("DBDel", 3, new DBDelCmd) &&
+      cmdMgr->regCmd("DBFilter", 3, new DBFilterCmd) &&
+      cmdMgr->regCmd("DBGroup", 3, new DBGroupCmd) &&
+      cmdMgr->regCmd("DBIndex", 3, new DBIndexCmd) &&
+      cmdMgr->regCmd("DBJoin", 3, new DBJoinCmd) &&
+      cmdMgr->regCmd("DBLoad", 3, new DBLoadCmd) &&
       cmdMgr->regCmd("DBMax", 4, new DBMaxCmd) && 
       cmdMgr->regCmd("DBMin", 4, new DBMinCmd) &&     
       cmdMgr->regCmd("DBPrint", 3, new DBPrintCmd) &&
+      cmdMgr->regCmd("DBQuantile", 3, new DBQuantileCmd) &&
       cmdMgr->regCmd("DBRead", 3, new DBReadCmd) &&
+      cmdMgr->regCmd("DBSAve", 4, new DBSaveCmd) &&
+      cmdMgr->regCmd("DBSCan", 4, new DBScanCmd) &&
+      cmdMgr->regCmd("DBSElect", 4, new DBSelectCmd) &&
       cmdMgr->regCmd("DBSort", 4, new DBSortCmd) &&
-      cmdMgr->regCmd("DBSum", 4, new DBSumCmd) )) 
+      cmdMgr->regCmd("DBSum", 4, new DBSumCmd) &&
+      cmdMgr->regCmd("DBTop", 3, new DBTopCmd) &&
+      cmdMgr->regCmd("DBUse", 3, new DBUseCmd) )) 
    {
    cerr << "Registering \"dbCmd\" commands fails... exiting" << endl;
    return false;
@@ -75,76 +214,90 @@ initDbCmd()
 }
 
 //----------------------------------------------------------------------
-//    DBAPpend <-Row | -Column> <(int data)...>
+//    DBAPpend <-Row (int data)... [-Row (int data)...]...
+//             | -Column (int data)... | -File (string csvFile)>
 //----------------------------------------------------------------------
+// Every "-Row" starts a new row; all the rows of one command are appended
+// as a batch by DBTable::addRows(). A row has at most #columns cells (the
+// first row of an empty table decides it) and the missing ones are nulls;
+// likewise for a column and #rows. '.' is a null cell. "-File" appends the
+// lines of a csv file, even if the table is not empty (cf. DBRead).
 CmdExecStatus
 DBAppendCmd::exec(const string& option)
 {
-   int temp=0;
    vector<string> options;
    if (!CmdExec::lexOptions(option, options))
       return CMD_EXEC_ERROR;
    if (options.empty())
       return CmdExec::errorOption(CMD_OPT_MISSING, "");
-   if (myStrNCmp("-Row", options[0], 2) == 0) {
-      DBRow r;
-      if (options.size()-2>dbtbl.nRows())
-         return CmdExec::errorOption(CMD_OPT_EXTRA,options[dbtbl.nRows()+1]);
-      for (int i=1 ; i<options.size() ; i++) {
-         if (!myStr2Int(options[i],temp)) {
-            if (options[i] == ".")
-               r.addData(INT_MAX);
-            else {
-               cerr << "Error: " << options[i] << " is not a number!!\n";
-               return CMD_EXEC_ERROR;
-            }
-         }
-         r.addData(temp);
+
+   if (myStrNCmp("-File", options[0], 2) == 0) {
+      if (options.size() < 2)
+         return CmdExec::errorOption(CMD_OPT_MISSING, options[0]);
+      if (options.size() > 2)
+         return CmdExec::errorOption(CMD_OPT_EXTRA, options[2]);
+      DBMappedFile f;
+      if (!f.open(options[1])) {
+         cerr << "Error: \"" << options[1] << "\" does not exist!!" << endl;
+         return CMD_EXEC_ERROR;
       }
-      while (r.size() < dbtbl.nRows()) 
-         r.addData(INT_MAX);
-      dbtbl.addRow(r);
+      double t = wallClock();
+      size_t n = dbtbl.addCsv(f.data(), f.data() + f.size());
+      t = wallClock() - t;
+      ios_base::fmtflags origFlags = cout.flags();
+      streamsize origPrec = cout.precision();
+      cout << n << " rows were appended in " << fixed << setprecision(3)
+           << t << " s." << endl;
+      cout.flags(origFlags);
+      cout.precision(origPrec);
       return CMD_EXEC_DONE;
    }
 
-   if (myStrNCmp("-Column", options[0], 2) == 0) {
-      vector<int> paras;
-      if (options.size()-2>dbtbl.nCols())
-         return CmdExec::errorOption(CMD_OPT_EXTRA,options[dbtbl.nCols()+1]);
-      for (int i=1 ; i<options.size() ; i++) {
-         if (!myStr2Int(options[i],temp)) {
-            if (options[i] == ".")
-               paras.push_back(INT_MAX);
-            else {
-               cerr << "Error: " << options[i] << " is not a number!!\n";
-               return CMD_EXEC_ERROR;
-            }
-         }
-         paras.push_back(temp);
+   bool isRow = myStrNCmp("-Row", options[0], 2) == 0;
+   if (!isRow && myStrNCmp("-Column", options[0], 2) != 0)
+      return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[0]);
+   // the max #cells of a row (0: to be decided by the first row)
+   size_t width = isRow? dbtbl.nCols(): dbtbl.nRows();
+   if (!isRow && !dbtbl.nCols()) width = 0;
+   vector<int> cells;
+   size_t n = 0, c = 0;   // #rows so far, #cells of the current row
+   for (size_t i = 1, m = options.size(); i <= m; ++i) {
+      if (i == m || (isRow && myStrNCmp("-Row", options[i], 2) == 0)) {
+         if (!width && !(width = c))
+            return CmdExec::errorOption(CMD_OPT_MISSING, options[i - 1]);
+         cells.resize(++n * width, INT_MAX);   // pad the missing cells
+         c = 0;
+         continue;
       }
-      while (paras.size() < dbtbl.nCols()) 
-         paras.push_back(INT_MAX);
-      dbtbl.addCol(paras);
-      return CMD_EXEC_DONE;
-   }   
-   // TODO...
-   // check option
-
-
+      if (width && c == width)
+         return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+      int d;
+      if (options[i] == ".") d = INT_MAX;
+      else if (!myStr2Int(options[i], d)) {
+         cerr << "Error: " << options[i] << " is not a number!!\n";
+         return CMD_EXEC_ERROR;
+      }
+      cells.push_back(d);
+      ++c;
+   }
+   if (isRow) dbtbl.addRows(cells.data(), n, width);
+   else if (!dbtbl.addCol(cells))   // longer than the table
+      return CmdExec::errorOption(CMD_OPT_EXTRA, options[dbtbl.nRows() + 1]);
    return CMD_EXEC_DONE;
 }
 
 void
 DBAppendCmd::usage(ostream& os) const
 {
-   os << "Usage: DBAPpend <-Row | -Column> <(int data)...>" << endl;
+   os << "Usage: DBAPpend <-Row (int data)... [-Row (int data)...]... "
+      << "| -Column (int data)... | -File (string csvFile)>" << endl;
 }
 
 void
 DBAppendCmd::help() const
 {
    cout << setw(15) << left << "DBAPpend: "
-        << "append a row or column of data to the table" << endl;
+        << "append rows or a column of data to the table" << endl;
 }
 
 
@@ -159,13 +312,15 @@ DBAveCmd::exec(const string& option)
    if (!CmdExec::lexSingleOption(option, token, false))
       return CMD_EXEC_ERROR;
    int c;
-   if (!checkColIdx(option, c)) return CMD_EXEC_ERROR;
+   if (!checkColIdx(token, c)) return CMD_EXEC_ERROR;
 
    float a = dbtbl.getAve(c);
    ios_base::fmtflags origFlags = cout.flags();
+   streamsize origPrec = cout.precision();
    cout << "The average of column " << c << " is " << fixed
         << setprecision(2) << a << ".\n";
    cout.flags(origFlags);
+   cout.precision(origPrec);
 
    return CMD_EXEC_DONE;
 }
@@ -185,20 +340,92 @@ DBAveCmd::help() const
 
 
 //----------------------------------------------------------------------
-//    DBCount <(int colIdx)>
+//    DBCOMpact
+//----------------------------------------------------------------------
+CmdExecStatus
+DBCompactCmd::exec(const string& option)
+{
+   // check option
+   string token;
+   if (!CmdExec::lexSingleOption(option, token))
+      return CMD_EXEC_ERROR;
+   if (token.size()) return CmdExec::errorOption(CMD_OPT_EXTRA, token);
+
+   if (!dbtbl) {
+      cerr << "Error: Table is not yet created!!" << endl;
+      return CMD_EXEC_ERROR;
+   }
+   size_t nDeleted = dbtbl.nDeleted();
+   double t = wallClock();
+   dbtbl.compact();
+   t = wallClock() - t;
+   ios_base::fmtflags origFlags = cout.flags();
+   streamsize origPrec = cout.precision();
+   cout << "(" << nDeleted << " deleted rows compacted in " << fixed
+        << setprecision(2) << t * 1000 << " ms)" << endl;
+   cout.flags(origFlags);
+   cout.precision(origPrec);
+
+   return CMD_EXEC_DONE;
+}
+
+void
+DBCompactCmd::usage(ostream& os) const
+{
+   os << "Usage: DBCOMpact" << endl;
+}
+
+void
+DBCompactCmd::help() const
+{
+   cout << setw(15) << left << "DBCOMpact: "
+        << "drop the storage of the deleted rows" << endl;
+}
+
+
+//----------------------------------------------------------------------
+//    DBCount <(int colIdx)> [-Approx]
 //----------------------------------------------------------------------
 CmdExecStatus
 DBCountCmd::exec(const string& option)
 {  
    // check option
-   string token;
-   if (!CmdExec::lexSingleOption(option, token, false))
+   vector<string> options;
+   if (!CmdExec::lexOptions(option, options))
       return CMD_EXEC_ERROR;
+   if (options.empty())
+      return CmdExec::errorOption(CMD_OPT_MISSING, "");
+
+   bool doApprox = false;
+   string token;
+   for (size_t i = 0, n = options.size(); i < n; ++i) {
+      if (myStrNCmp("-Approx", options[i], 2) == 0) {
+         if (doApprox) return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         doApprox = true;
+      }
+      else {
+         if (token.size())
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         token = options[i];
+      }
+   }
+   if (token.empty())
+      return CmdExec::errorOption(CMD_OPT_MISSING, "");
    int c;
-   if (!checkColIdx(option, c)) return CMD_EXEC_ERROR;
+   if (!checkColIdx(token, c)) return CMD_EXEC_ERROR;
 
-   int n = dbtbl.getCount(c);
-   cout << "The distinct count of column " << c << " is " << n << "." << endl;
+   double relErr = 0, t = wallClock();
+   int n = doApprox? dbtbl.getApproxCount(c, relErr): dbtbl.getCount(c);
+   t = wallClock() - t;
+   cout << "The " << (doApprox? "approximate ": "") << "distinct count of "
+        << "column " << c << " is " << n << "." << endl;
+   ios_base::fmtflags origFlags = cout.flags();
+   streamsize origPrec = cout.precision();
+   cout << "(" << (doApprox? "HyperLogLog": "exact") << ", relative error "
+        << fixed << setprecision(2) << relErr * 100 << "%, "
+        << t * 1000 << " ms)" << endl;
+   cout.flags(origFlags);
+   cout.precision(origPrec);
 
    return CMD_EXEC_DONE;
 }
@@ -206,7 +433,7 @@ DBCountCmd::exec(const string& option)
 void
 DBCountCmd::usage(ostream& os) const
 {     
-   os << "Usage: DBCount <(int colIdx)>" << endl;
+   os << "Usage: DBCount <(int colIdx)> [-Approx]" << endl;
 }
 
 void
@@ -260,6 +487,395 @@ DBDelCmd::help() const
 }
 
 
+//----------------------------------------------------------------------
+//    DBFilter <(string expr)>
+//             [-Sum | -MAx | -MIn | -Ave | -Count <(int colIdx)>
+//              | -Into (string table)]
+//----------------------------------------------------------------------
+// The expression is made of all the tokens before the first option (see
+// dbFilter.h), e.g. DBFilter "c2 > 10 && c5 != null" -Sum 3. The selected
+// rows are printed, aggregated, or copied into a table of the catalog.
+CmdExecStatus
+DBFilterCmd::exec(const string& option)
+{
+   // check option
+   vector<string> options;
+   if (!CmdExec::lexOptions(option, options))
+      return CMD_EXEC_ERROR;
+   if (!dbtbl) {
+      cerr << "Error: Table is not yet created!!" << endl;
+      return CMD_EXEC_ERROR;
+   }
+
+   string expr, into;
+   size_t i = 0, n = options.size();
+   for (; i < n; ++i) {
+      if (parseAggOp(options[i]) != DB_AGG_NONE ||
+          myStrNCmp("-Into", options[i], 2) == 0) break;
+      if (expr.size()) expr += ' ';
+      expr += options[i];
+   }
+   if (expr.empty())
+      return CmdExec::errorOption(CMD_OPT_MISSING, "");
+   DBAggOp op = DB_AGG_NONE;
+   int ac = -1;
+   if (i < n) {
+      op = parseAggOp(options[i]);
+      if (i + 1 == n)
+         return CmdExec::errorOption(CMD_OPT_MISSING, options[i]);
+      if (i + 2 < n)
+         return CmdExec::errorOption(CMD_OPT_EXTRA, options[i + 2]);
+      if (op == DB_AGG_NONE) into = options[i + 1];
+      else if (!checkColIdx(options[i + 1], ac)) return CMD_EXEC_ERROR;
+   }
+   DBFilter f;
+   string err;
+   if (!f.compile(expr, dbtbl.nCols(), err)) {
+      cerr << "Error: " << err << "!!" << endl;
+      return CMD_EXEC_ERROR;
+   }
+
+   vector<uint32_t> rows;
+   double t = wallClock();
+   dbtbl.filter(f, rows);
+   if (into.size()) {
+      DBTable res;
+      res.gather(dbtbl, rows);
+      t = wallClock() - t;
+      DBTable* t2 = findTable(into);
+      if (!t2) t2 = &dbCatalog[into];
+      else if (*t2) cout << "Table \"" << into << "\" is replaced..." << endl;
+      t2->swap(res);
+      ios_base::fmtflags origFlags = cout.flags();
+      streamsize origPrec = cout.precision();
+      cout << "(" << rows.size() << " rows filtered into \"" << into
+           << "\" in " << fixed << setprecision(2) << t * 1000 << " ms)"
+           << endl;
+      cout.flags(origFlags);
+      cout.precision(origPrec);
+      return CMD_EXEC_DONE;
+   }
+   if (op == DB_AGG_NONE) {
+      t = wallClock() - t;
+      for (size_t i = 0, n = rows.size(); i < n; ++i)
+         cout << DBRowView(dbtbl, rows[i]) << endl;
+   }
+   else {
+      DBColAgg a;
+      size_t nDistinct = 0;
+      if (op == DB_AGG_COUNT) nDistinct = dbtbl.countDistinct(ac, rows);
+      else dbtbl.aggregate(ac, rows, a);
+      t = wallClock() - t;
+      cout << "The " << aggOpName(op) << " of column " << ac
+           << " in the selected rows is ";
+      printAgg(cout, op, a, nDistinct);
+      cout << "." << endl;
+   }
+   ios_base::fmtflags origFlags = cout.flags();
+   streamsize origPrec = cout.precision();
+   cout << "(" << rows.size() << " rows selected by filter in " << fixed
+        << setprecision(2) << t * 1000 << " ms)" << endl;
+   cout.flags(origFlags);
+   cout.precision(origPrec);
+
+   return CMD_EXEC_DONE;
+}
+
+void
+DBFilterCmd::usage(ostream& os) const
+{
+   os << "Usage: DBFilter <(string expr)>" << endl
+      << "                [-Sum | -MAx | -MIn | -Ave | -Count <(int colIdx)>"
+      << endl
+      << "                 | -Into (string table)]" << endl;
+}
+
+void
+DBFilterCmd::help() const
+{
+   cout << setw(15) << left << "DBFilter: "
+        << "select the rows satisfying an expression" << endl;
+}
+
+
+//----------------------------------------------------------------------
+//    DBGroup <(int keyColIdx)> <(int aggColIdx)>
+//            <-Sum | -MAx | -MIn | -Ave | -Count> [-Threads (int n)]
+//----------------------------------------------------------------------
+CmdExecStatus
+DBGroupCmd::exec(const string& option)
+{
+   // check option
+   vector<string> options;
+   if (!CmdExec::lexOptions(option, options))
+      return CMD_EXEC_ERROR;
+
+   vector<string> cols;
+   DBAggOp op = DB_AGG_NONE;
+   int nThreads = 0;
+   for (size_t i = 0, n = options.size(); i < n; ++i) {
+      if (myStrNCmp("-Threads", options[i], 2) == 0) {
+         if (nThreads) return CmdExec::errorOption(CMD_OPT_EXTRA,options[i]);
+         if (++i == n)
+            return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
+         if (!myStr2Int(options[i], nThreads) || nThreads <= 0)
+            return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+      }
+      else if (options[i][0] == '-' && parseAggOp(options[i]) != DB_AGG_NONE) {
+         if (op != DB_AGG_NONE)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         op = parseAggOp(options[i]);
+      }
+      else if (cols.size() < 2) cols.push_back(options[i]);
+      else return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+   }
+   if (cols.size() < 2 || op == DB_AGG_NONE)
+      return CmdExec::errorOption(CMD_OPT_MISSING, "");
+   int kc, ac;
+   if (!checkColIdx(cols[0], kc) || !checkColIdx(cols[1], ac))
+      return CMD_EXEC_ERROR;
+   if (!nThreads) nThreads = 1;
+
+   vector<DBGroup> groups;
+   double t = wallClock();
+   dbtbl.group(kc, ac, groups, nThreads);
+   t = wallClock() - t;
+   for (size_t i = 0, n = groups.size(); i < n; ++i) {
+      const DBColAgg& a = groups[i]._agg;
+      DBTable::printData(cout, groups[i]._key);
+      cout << ' ';
+      printAgg(cout, op, a, a._count);
+      cout << endl;
+   }
+   ios_base::fmtflags origFlags = cout.flags();
+   streamsize origPrec = cout.precision();
+   cout << "(" << groups.size() << " groups in " << fixed << setprecision(2)
+        << t * 1000 << " ms)" << endl;
+   cout.flags(origFlags);
+   cout.precision(origPrec);
+
+   return CMD_EXEC_DONE;
+}
+
+void
+DBGroupCmd::usage(ostream& os) const
+{
+   os << "Usage: DBGroup <(int keyColIdx)> <(int aggColIdx)>" << endl
+      << "               <-Sum | -MAx | -MIn | -Ave | -Count> "
+      << "[-Threads (int n)]" << endl;
+}
+
+void
+DBGroupCmd::help() const
+{
+   cout << setw(15) << left << "DBGroup: "
+        << "aggregate a column per value of another column" << endl;
+}
+
+
+//----------------------------------------------------------------------
+//    DBIndex <(int colIdx)>
+//----------------------------------------------------------------------
+CmdExecStatus
+DBIndexCmd::exec(const string& option)
+{
+   // check option
+   string token;
+   if (!CmdExec::lexSingleOption(option, token, false))
+      return CMD_EXEC_ERROR;
+   int c;
+   if (!checkColIdx(token, c)) return CMD_EXEC_ERROR;
+
+   double t = wallClock();
+   dbtbl.buildIndex(c);
+   t = wallClock() - t;
+   ios_base::fmtflags origFlags = cout.flags();
+   streamsize origPrec = cout.precision();
+   cout << "Column " << c << " is indexed (" << dbtbl.getCol(c).nValid()
+        << " keys in " << fixed << setprecision(2) << t * 1000 << " ms)."
+        << endl;
+   cout.flags(origFlags);
+   cout.precision(origPrec);
+
+   return CMD_EXEC_DONE;
+}
+
+void
+DBIndexCmd::usage(ostream& os) const
+{
+   os << "Usage: DBIndex <(int colIdx)>" << endl;
+}
+
+void
+DBIndexCmd::help() const
+{
+   cout << setw(15) << left << "DBIndex: "
+        << "build a sorted index on a column" << endl;
+}
+
+
+//----------------------------------------------------------------------
+//    DBJoin <(string t1).(int colIdx)> <(string t2).(int colIdx)>
+//           -Into <(string t3)> [-MemLimit (int MB)[K]]
+//----------------------------------------------------------------------
+CmdExecStatus
+DBJoinCmd::exec(const string& option)
+{
+   // check option
+   vector<string> options;
+   if (!CmdExec::lexOptions(option, options))
+      return CMD_EXEC_ERROR;
+
+   vector<string> keys;
+   string into;
+   size_t memLimit = 0;
+   for (size_t i = 0, n = options.size(); i < n; ++i) {
+      if (myStrNCmp("-Into", options[i], 2) == 0) {
+         if (into.size()) return CmdExec::errorOption(CMD_OPT_EXTRA,options[i]);
+         if (++i == n)
+            return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
+         into = options[i];
+      }
+      else if (myStrNCmp("-MemLimit", options[i], 2) == 0) {
+         if (memLimit) return CmdExec::errorOption(CMD_OPT_EXTRA,options[i]);
+         if (++i == n)
+            return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
+         if (!str2MemLimit(options[i], memLimit))
+            return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+      }
+      else if (keys.size() < 2) keys.push_back(options[i]);
+      else return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+   }
+   if (keys.size() < 2 || into.empty())
+      return CmdExec::errorOption(CMD_OPT_MISSING, "");
+   DBTable* t1, *t2;
+   int c1, c2;
+   if (!checkTableCol(keys[0], t1, c1) || !checkTableCol(keys[1], t2, c2))
+      return CMD_EXEC_ERROR;
+   if (!memLimit) memLimit = size_t(256) << 20;
+
+   DBTable res;
+   size_t nSpilled = 0;
+   double t = wallClock();
+   if (!res.join(*t1, c1, *t2, c2, memLimit, nSpilled)) {
+      cerr << "Error: Temporary files for spilling cannot be written!!"
+           << endl;
+      return CMD_EXEC_ERROR;
+   }
+   t = wallClock() - t;
+   DBTable* t3 = findTable(into);
+   if (!t3) t3 = &dbCatalog[into];
+   else if (*t3) cout << "Table \"" << into << "\" is replaced..." << endl;
+   t3->swap(res);
+   ios_base::fmtflags origFlags = cout.flags();
+   streamsize origPrec = cout.precision();
+   cout << "(" << t3->nRows() << " rows joined into \"" << into << "\" in "
+        << fixed << setprecision(2) << t * 1000 << " ms";
+   if (nSpilled) cout << "; " << nSpilled << " bytes spilled";
+   cout << ")" << endl;
+   cout.flags(origFlags);
+   cout.precision(origPrec);
+
+   return CMD_EXEC_DONE;
+}
+
+void
+DBJoinCmd::usage(ostream& os) const
+{
+   os << "Usage: DBJoin <(string t1).(int colIdx)> <(string t2).(int colIdx)>"
+      << endl
+      << "              -Into <(string t3)> [-MemLimit (int MB)[K]]" << endl;
+}
+
+void
+DBJoinCmd::help() const
+{
+   cout << setw(15) << left << "DBJoin: "
+        << "join two tables on equal column values" << endl;
+}
+
+
+//----------------------------------------------------------------------
+//    DBLoad <(string snapshotFile)> [-Replace] [-Threads (int n)]
+//----------------------------------------------------------------------
+CmdExecStatus
+DBLoadCmd::exec(const string& option)
+{
+   // check option
+   vector<string> options;
+   if (!CmdExec::lexOptions(option, options))
+      return CMD_EXEC_ERROR;
+
+   if (options.empty())
+      return CmdExec::errorOption(CMD_OPT_MISSING, "");
+
+   bool doReplace = false;
+   int nThreads = 0;
+   string fileName;
+   for (size_t i = 0, n = options.size(); i < n; ++i) {
+      if (myStrNCmp("-Replace", options[i], 2) == 0) {
+         if (doReplace) return CmdExec::errorOption(CMD_OPT_EXTRA,options[i]);
+         doReplace = true;
+      }
+      else if (myStrNCmp("-Threads", options[i], 2) == 0) {
+         if (nThreads) return CmdExec::errorOption(CMD_OPT_EXTRA,options[i]);
+         if (++i == n)
+            return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
+         if (!myStr2Int(options[i], nThreads) || nThreads <= 0)
+            return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+      }
+      else {
+         if (fileName.size())
+            return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+         fileName = options[i];
+      }
+   }
+   if (fileName.empty())
+      return CmdExec::errorOption(CMD_OPT_MISSING, "");
+   if (!nThreads) nThreads = 1;
+
+   ifstream ifs(fileName.c_str());
+   if (!ifs) {
+      cerr << "Error: \"" << fileName << "\" does not exist!!" << endl;
+      return CMD_EXEC_ERROR;
+   }
+
+   if (dbtbl && !doReplace) {
+      cerr << "Error: Table exists. Use \"-Replace\" option for "
+           << "replacement.\n";
+      return CMD_EXEC_ERROR;
+   }
+   bool replaced = bool(dbtbl);
+   size_t nBytes = 0;
+   double t = wallClock();
+   if (!dbtbl.load(fileName, nThreads, nBytes)) {
+      cerr << "Error: \"" << fileName << "\" is not a valid table snapshot!!"
+           << endl;
+      return CMD_EXEC_ERROR;
+   }
+   t = wallClock() - t;
+   if (replaced) cout << "Table is replaced..." << endl;
+   cout << "\"" << fileName << "\" was loaded successfully." << endl;
+   printIOStat(dbtbl.nRows(), nBytes, t);
+
+   return CMD_EXEC_DONE;
+}
+
+void
+DBLoadCmd::usage(ostream& os) const
+{
+   os << "Usage: DBLoad <(string snapshotFile)> [-Replace] [-Threads (int n)]"
+      << endl;
+}
+
+void
+DBLoadCmd::help() const
+{
+   cout << setw(15) << left << "DBLoad: "
+        << "load the table from a binary snapshot" << endl;
+}
+
+
 //----------------------------------------------------------------------
 //    DBMAx <(int colIdx)>
 //----------------------------------------------------------------------
@@ -271,7 +887,7 @@ DBMaxCmd::exec(const string& option)
    if (!CmdExec::lexSingleOption(option, token, false))
       return CMD_EXEC_ERROR;
    int c;
-   if (!checkColIdx(option, c)) return CMD_EXEC_ERROR;
+   if (!checkColIdx(token, c)) return CMD_EXEC_ERROR;
 
    float n = dbtbl.getMax(c);
    cout << "The max data of column " << c << " is " << n << "." << endl;
@@ -304,7 +920,7 @@ DBMinCmd::exec(const string& option)
    if (!CmdExec::lexSingleOption(option, token, false))
       return CMD_EXEC_ERROR;
    int c;
-   if (!checkColIdx(option, c)) return CMD_EXEC_ERROR;
+   if (!checkColIdx(token, c)) return CMD_EXEC_ERROR;
 
    float n = dbtbl.getMin(c);
    cout << "The min data of column " << c << " is " << n << "." << endl;
@@ -329,6 +945,7 @@ DBMinCmd::help() const
 //----------------------------------------------------------------------
 //    DBPrint < (int rowIdx) (int colIdx)
 //            | -Row (int rowIdx) | -Column (colIdx) | -Table | -Summary>
+//            [-File (string fileName)]
 //----------------------------------------------------------------------
 CmdExecStatus
 DBPrintCmd::exec(const string& option)
@@ -336,56 +953,84 @@ DBPrintCmd::exec(const string& option)
    vector<string> options;
    if (!CmdExec::lexOptions(option, options))
       return CMD_EXEC_ERROR;
+   string fileName;
+   for (size_t i = 0; i < options.size(); ++i) {
+      if (myStrNCmp("-File", options[i], 2) != 0) continue;
+      if (fileName.size()) return CmdExec::errorOption(CMD_OPT_EXTRA,options[i]);
+      if (i + 1 == options.size())
+         return CmdExec::errorOption(CMD_OPT_MISSING, options[i]);
+      fileName = options[i + 1];
+      options.erase(options.begin() + i, options.begin() + i + 2);
+      --i;
+   }
    if (options.empty())
       return CmdExec::errorOption(CMD_OPT_MISSING, "");
-   if (myStrNCmp("-Table", options[0], 2) == 0) {
-      if (options.size() > 1)   return CmdExec::errorOption(CMD_OPT_EXTRA,options[1]);
-      else {
-         cout << dbtbl;
-         return CMD_EXEC_DONE;
-      }
-   }
-   if (myStrNCmp("-Summary", options[0], 2) == 0) {
+   // all the options are checked before the file is opened (and truncated)
+   enum { PRINT_TABLE, PRINT_SUMMARY, PRINT_ROW, PRINT_COLUMN, PRINT_CELL }
+      what = PRINT_CELL;
+   int r = 0, c = 0;
+   if (myStrNCmp("-Table", options[0], 2) == 0) what = PRINT_TABLE;
+   else if (myStrNCmp("-Summary", options[0], 2) == 0) what = PRINT_SUMMARY;
+   else if (myStrNCmp("-Row", options[0], 2) == 0) what = PRINT_ROW;
+   else if (myStrNCmp("-Column", options[0], 2) == 0) what = PRINT_COLUMN;
+   if (what == PRINT_TABLE || what == PRINT_SUMMARY) {
       if (options.size() > 1)   return CmdExec::errorOption(CMD_OPT_EXTRA,options[1]);
-      else {
-         int datanum=0;
-         for (int i=0 ; i<dbtbl.nRows() ; i++) {
-            for (int j=0 ; j<dbtbl.nCols() ; j++) {
-               if (dbtbl[i][j] != INT_MAX) 
-                  datanum++;
-            }
-         }
-         cout << "(#rows, #cols, #data) = (" << dbtbl.nRows() << ", " << dbtbl.nCols() << ", " << datanum << ')';
-         return CMD_EXEC_DONE;
-      }
    }
-   if (myStrNCmp("-Row", options[0], 2) == 0) {
-      int i;
-      if (options.size() > 2)   return CmdExec::errorOption(CMD_OPT_EXTRA,options[2]);
-      if (!checkRowIdx(options[1],i))  return CMD_EXEC_ERROR;
-      else   {
-         cout << dbtbl[i];
-         return CMD_EXEC_DONE;
-      }   
-   }
-   if (myStrNCmp("-Column", options[0], 2) == 0) {
-      int i;
+   else {
+      if (options.size() < 2)   return CmdExec::errorOption(CMD_OPT_MISSING,options[0]);
       if (options.size() > 2)   return CmdExec::errorOption(CMD_OPT_EXTRA,options[2]);
-      if (!checkRowIdx(options[1],i))  return CMD_EXEC_ERROR;
-      else   {
-         dbtbl.printCol(i);
-         return CMD_EXEC_DONE;
+      if (what == PRINT_ROW && !checkRowIdx(options[1],r))
+         return CMD_EXEC_ERROR;
+      if (what == PRINT_COLUMN && !checkColIdx(options[1],c))
+         return CMD_EXEC_ERROR;
+      if (what == PRINT_CELL &&
+          (!checkRowIdx(options[0],r) || !checkColIdx(options[1],c)))
+         return CMD_EXEC_ERROR;
+   }
+   // a dump to a file bypasses the terminal
+   ofstream ofs;
+   if (fileName.size()) {
+      ofs.open(fileName.c_str());
+      if (!ofs) {
+         cerr << "Error: \"" << fileName << "\" cannot be written!!" << endl;
+         return CMD_EXEC_ERROR;
       }
    }
-   int ii,iii;
-   if (checkRowIdx(options[0],ii)) {
-      if (checkColIdx(options[1],iii)) {
-         if (dbtbl[ii][iii]==INT_MAX)
-            cout << "NULL" << endl;
+   ostream& os = fileName.size()? ofs: cout;
+   size_t nRows = 0;   // #rows written
+   double t = wallClock();
+   switch (what) {
+      case PRINT_TABLE:
+         os << dbtbl;
+         nRows = dbtbl.nRows();
+         break;
+      case PRINT_SUMMARY:
+         dbtbl.printSummary(os);
+         break;
+      case PRINT_ROW:
+         os << dbtbl[r];
+         nRows = 1;
+         break;
+      case PRINT_COLUMN:
+         dbtbl.printCol(c, os);
+         nRows = dbtbl.nRows();
+         break;
+      case PRINT_CELL:
+         if (dbtbl[r][c]==INT_MAX)
+            os << "NULL" << endl;
          else 
-            cout << dbtbl[ii][iii] << endl;
-         return CMD_EXEC_DONE;
-      }
+            os << dbtbl[r][c] << endl;
+         nRows = 1;
+         break;
+   }
+   if (fileName.size()) {
+      ofs.close();
+      t = wallClock() - t;
+      cout << "Table was printed to \"" << fileName << "\"." << endl;
+      size_t nBytes = 0;
+      ifstream ifs(fileName.c_str(), ios::binary | ios::ate);
+      if (ifs) nBytes = size_t(ifs.tellg());
+      printIOStat(nRows, nBytes, t);
    }
    // TODO...
    return CMD_EXEC_DONE;
@@ -395,7 +1040,8 @@ void
 DBPrintCmd::usage(ostream& os) const
 {
    os << "DBPrint < (int rowIdx) (int colIdx)\n"
-      << "        | -Row (int rowIdx) | -Column (colIdx) | -Table>" << endl;
+      << "        | -Row (int rowIdx) | -Column (colIdx) | -Table | -Summary>\n"
+      << "        [-File (string fileName)]" << endl;
 }
 
 void
@@ -407,7 +1053,82 @@ DBPrintCmd::help() const
 
 
 //----------------------------------------------------------------------
-//    DBRead <(string csvFile)> [-Replace]
+//    DBQuantile <(int colIdx)> <(double p)>... [-Approx]
+//----------------------------------------------------------------------
+// The p-quantile (0 <= p <= 1) is by the nearest rank over the non-null
+// cells, so the 0- and the 1-quantiles agree with DBMIn and DBMAx.
+CmdExecStatus
+DBQuantileCmd::exec(const string& option)
+{
+   // check option
+   vector<string> options;
+   if (!CmdExec::lexOptions(option, options))
+      return CMD_EXEC_ERROR;
+
+   bool doApprox = false;
+   string token;
+   vector<string> pTokens;
+   vector<double> p;
+   for (size_t i = 0, n = options.size(); i < n; ++i) {
+      if (myStrNCmp("-Approx", options[i], 2) == 0) {
+         if (doApprox) return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         doApprox = true;
+      }
+      else if (token.empty()) token = options[i];
+      else {
+         const char* s = options[i].c_str();
+         char* e;
+         double d = strtod(s, &e);
+         if (e == s || *e || !(d >= 0 && d <= 1))
+            return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+         pTokens.push_back(options[i]);
+         p.push_back(d);
+      }
+   }
+   if (p.empty())
+      return CmdExec::errorOption(CMD_OPT_MISSING, "");
+   int c;
+   if (!checkColIdx(token, c)) return CMD_EXEC_ERROR;
+
+   vector<int> q;
+   double rankErr = 0, t = wallClock();
+   bool ok = doApprox? dbtbl.approxQuantiles(c, p, q, rankErr):
+                       dbtbl.quantiles(c, p, q);
+   t = wallClock() - t;
+   for (size_t i = 0, n = p.size(); i < n; ++i) {
+      cout << "The " << (doApprox? "approximate ": "") << pTokens[i]
+           << "-quantile of column " << c << " is ";
+      if (ok) cout << q[i];
+      else cout << float(NAN);
+      cout << "." << endl;
+   }
+   ios_base::fmtflags origFlags = cout.flags();
+   streamsize origPrec = cout.precision();
+   cout << "(" << (doApprox? "KLL sketch": "exact") << ", rank error "
+        << fixed << setprecision(2) << rankErr * 100 << "%, "
+        << t * 1000 << " ms)" << endl;
+   cout.flags(origFlags);
+   cout.precision(origPrec);
+
+   return CMD_EXEC_DONE;
+}
+
+void
+DBQuantileCmd::usage(ostream& os) const
+{
+   os << "Usage: DBQuantile <(int colIdx)> <(double p)>... [-Approx]" << endl;
+}
+
+void
+DBQuantileCmd::help() const
+{
+   cout << setw(15) << left << "DBQuantile: "
+        << "report the quantiles of a column" << endl;
+}
+
+
+//----------------------------------------------------------------------
+//    DBRead <(string csvFile)> [-Replace] [-Threads (int n)]
 //----------------------------------------------------------------------
 CmdExecStatus
 DBReadCmd::exec(const string& option)
@@ -421,18 +1142,29 @@ DBReadCmd::exec(const string& option)
       return CmdExec::errorOption(CMD_OPT_MISSING, "");
 
    bool doReplace = false;
+   int nThreads = 0;
    string fileName;
    for (size_t i = 0, n = options.size(); i < n; ++i) {
       if (myStrNCmp("-Replace", options[i], 2) == 0) {
          if (doReplace) return CmdExec::errorOption(CMD_OPT_EXTRA,options[i]);
          doReplace = true;
       }
+      else if (myStrNCmp("-Threads", options[i], 2) == 0) {
+         if (nThreads) return CmdExec::errorOption(CMD_OPT_EXTRA,options[i]);
+         if (++i == n)
+            return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
+         if (!myStr2Int(options[i], nThreads) || nThreads <= 0)
+            return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+      }
       else {
          if (fileName.size())
             return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
          fileName = options[i];
       }
    }
+   if (fileName.empty())
+      return CmdExec::errorOption(CMD_OPT_MISSING, "");
+   if (!nThreads) nThreads = 1;
 
    ifstream ifs(fileName.c_str());
    if (!ifs) {
@@ -449,8 +1181,26 @@ DBReadCmd::exec(const string& option)
       cout << "Table is replaced..." << endl;
       dbtbl.reset();
    }
-   if (!(ifs >> dbtbl)) return CMD_EXEC_ERROR;
+   size_t nBytes = 0, nRows = dbtbl.nRows();
+   double t = wallClock();
+   if (!dbtbl.readCsv(fileName, nThreads, nBytes)) {
+      cerr << "Error: \"" << fileName << "\" cannot be read!!" << endl;
+      return CMD_EXEC_ERROR;
+   }
+   t = wallClock() - t;
+   nRows = dbtbl.nRows() - nRows;
    cout << "\"" << fileName << "\" was read in successfully." << endl;
+   ios_base::fmtflags origFlags = cout.flags();
+   streamsize origPrec = cout.precision();
+   cout << "(" << nRows << " rows, " << nBytes << " bytes in " << fixed
+        << setprecision(3) << t << " s by " << nThreads << " thread"
+        << (nThreads > 1? "s": "") << "; " << setprecision(1);
+   if (t > 0)
+      cout << nBytes / t / (1 << 20) << " MB/s, " << setprecision(0)
+           << nRows / t << " rows/s)" << endl;
+   else cout << "too fast to measure)" << endl;
+   cout.flags(origFlags);
+   cout.precision(origPrec);
 
    return CMD_EXEC_DONE;
 }
@@ -458,7 +1208,8 @@ DBReadCmd::exec(const string& option)
 void
 DBReadCmd::usage(ostream& os) const
 {
-   os << "Usage: DBRead <(string csvFile)> [-Replace]" << endl;
+   os << "Usage: DBRead <(string csvFile)> [-Replace] [-Threads (int n)]"
+      << endl;
 }
 
 void
@@ -469,8 +1220,228 @@ DBReadCmd::help() const
 }
 
 
+//----------------------------------------------------------------------
+//    DBSAve <(string snapshotFile)> [-Compress]
+//----------------------------------------------------------------------
+CmdExecStatus
+DBSaveCmd::exec(const string& option)
+{
+   // check option
+   vector<string> options;
+   if (!CmdExec::lexOptions(option, options))
+      return CMD_EXEC_ERROR;
+
+   if (options.empty())
+      return CmdExec::errorOption(CMD_OPT_MISSING, "");
+
+   bool doCompress = false;
+   string fileName;
+   for (size_t i = 0, n = options.size(); i < n; ++i) {
+      if (myStrNCmp("-Compress", options[i], 2) == 0) {
+         if (doCompress)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         doCompress = true;
+      }
+      else {
+         if (fileName.size())
+            return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+         fileName = options[i];
+      }
+   }
+   if (fileName.empty())
+      return CmdExec::errorOption(CMD_OPT_MISSING, "");
+
+   if (!dbtbl) {
+      cerr << "Error: Table is not yet created!!" << endl;
+      return CMD_EXEC_ERROR;
+   }
+   size_t nBytes = 0;
+   double t = wallClock();
+   dbtbl.compact();
+   if (!dbtbl.save(fileName, doCompress, nBytes)) {
+      cerr << "Error: \"" << fileName << "\" cannot be written!!" << endl;
+      return CMD_EXEC_ERROR;
+   }
+   t = wallClock() - t;
+   cout << "Table was saved to \"" << fileName << "\"." << endl;
+   printIOStat(dbtbl.nRows(), nBytes, t);
+
+   return CMD_EXEC_DONE;
+}
+
+void
+DBSaveCmd::usage(ostream& os) const
+{
+   os << "Usage: DBSAve <(string snapshotFile)> [-Compress]" << endl;
+}
+
+void
+DBSaveCmd::help() const
+{
+   cout << setw(15) << left << "DBSAve: "
+        << "save the table to a binary snapshot" << endl;
+}
+
+
+//----------------------------------------------------------------------
+//    DBSCan <(string csvFile)> <-Sum | -MAx | -MIn | -Ave | -Count>
+//           <(int colIdx)>
+//----------------------------------------------------------------------
+CmdExecStatus
+DBScanCmd::exec(const string& option)
+{
+   // check option
+   vector<string> options;
+   if (!CmdExec::lexOptions(option, options))
+      return CMD_EXEC_ERROR;
+
+   vector<string> args;
+   DBAggOp op = DB_AGG_NONE;
+   for (size_t i = 0, n = options.size(); i < n; ++i) {
+      if (options[i][0] == '-' && parseAggOp(options[i]) != DB_AGG_NONE) {
+         if (op != DB_AGG_NONE)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         op = parseAggOp(options[i]);
+      }
+      else if (args.size() < 2) args.push_back(options[i]);
+      else return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+   }
+   if (args.size() < 2 || op == DB_AGG_NONE)
+      return CmdExec::errorOption(CMD_OPT_MISSING, "");
+   const string& fileName = args[0];
+   int c;
+   if (!myStr2Int(args[1], c)) {
+      cerr << "Error: " << args[1] << " is not a number!!\n";
+      return CMD_EXEC_ERROR;
+   }
+   if (c < 0) {
+      cerr << "Error: Column index " << c << " is out of range!!\n";
+      return CMD_EXEC_ERROR;
+   }
+
+   // the distinct count is sketched in fixed memory
+   DBColAgg a;
+   DBHyperLogLog hll;
+   size_t nCols = 0, nRows = 0, nBytes = 0;
+   double t = wallClock();
+   if (!dbScanCsv(fileName, c, a, op == DB_AGG_COUNT? &hll: 0, nCols, nRows,
+                  nBytes)) {
+      cerr << "Error: \"" << fileName << "\" cannot be read!!" << endl;
+      return CMD_EXEC_ERROR;
+   }
+   t = wallClock() - t;
+   if (nCols && size_t(c) >= nCols) {
+      cerr << "Error: Column index " << c << " is out of range!!\n";
+      return CMD_EXEC_ERROR;
+   }
+   cout << "The " << (op == DB_AGG_COUNT? "approximate ": "")
+        << aggOpName(op) << " of column " << c << " in \"" << fileName
+        << "\" is ";
+   printAgg(cout, op, a, size_t(hll.estimate() + 0.5));
+   cout << "." << endl;
+   printIOStat(nRows, nBytes, t);
+
+   return CMD_EXEC_DONE;
+}
+
+void
+DBScanCmd::usage(ostream& os) const
+{
+   os << "Usage: DBSCan <(string csvFile)> <-Sum | -MAx | -MIn | -Ave | "
+      << "-Count>" << endl
+      << "              <(int colIdx)>" << endl;
+}
+
+void
+DBScanCmd::help() const
+{
+   cout << setw(15) << left << "DBSCan: "
+        << "aggregate a column of a csv file without loading it" << endl;
+}
+
+
+//----------------------------------------------------------------------
+//    DBSElect <(int colIdx)> <(int lo)> <(int hi)>
+//             [-Sum | -MAx | -MIn | -Ave | -Count <(int colIdx)>]
+//----------------------------------------------------------------------
+CmdExecStatus
+DBSelectCmd::exec(const string& option)
+{
+   // check option
+   vector<string> options;
+   if (!CmdExec::lexOptions(option, options))
+      return CMD_EXEC_ERROR;
+   if (options.size() < 3)
+      return CmdExec::errorOption(CMD_OPT_MISSING, "");
+
+   int c, lo, hi, ac = -1;
+   if (!checkColIdx(options[0], c)) return CMD_EXEC_ERROR;
+   if (!myStr2Int(options[1], lo))
+      return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[1]);
+   if (!myStr2Int(options[2], hi))
+      return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[2]);
+   DBAggOp op = DB_AGG_NONE;
+   if (options.size() > 3) {
+      op = parseAggOp(options[3]);
+      if (op == DB_AGG_NONE)
+         return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[3]);
+      if (options.size() < 5)
+         return CmdExec::errorOption(CMD_OPT_MISSING, options[3]);
+      if (options.size() > 5)
+         return CmdExec::errorOption(CMD_OPT_EXTRA, options[5]);
+      if (!checkColIdx(options[4], ac)) return CMD_EXEC_ERROR;
+   }
+
+   vector<uint32_t> rows;
+   double t = wallClock();
+   bool byIndex = dbtbl.select(c, lo, hi, rows);
+   if (op == DB_AGG_NONE) {
+      t = wallClock() - t;
+      for (size_t i = 0, n = rows.size(); i < n; ++i)
+         cout << DBRowView(dbtbl, rows[i]) << endl;
+   }
+   else {
+      DBColAgg a;
+      size_t nDistinct = 0;
+      if (op == DB_AGG_COUNT) nDistinct = dbtbl.countDistinct(ac, rows);
+      else dbtbl.aggregate(ac, rows, a);
+      t = wallClock() - t;
+      cout << "The " << aggOpName(op) << " of column " << ac
+           << " in the selected rows is ";
+      printAgg(cout, op, a, nDistinct);
+      cout << "." << endl;
+   }
+   ios_base::fmtflags origFlags = cout.flags();
+   streamsize origPrec = cout.precision();
+   cout << "(" << rows.size() << " rows selected by "
+        << (byIndex? "index": "scan") << " in " << fixed << setprecision(2)
+        << t * 1000 << " ms)" << endl;
+   cout.flags(origFlags);
+   cout.precision(origPrec);
+
+   return CMD_EXEC_DONE;
+}
+
+void
+DBSelectCmd::usage(ostream& os) const
+{
+   os << "Usage: DBSElect <(int colIdx)> <(int lo)> <(int hi)>" << endl
+      << "                [-Sum | -MAx | -MIn | -Ave | -Count <(int colIdx)>]"
+      << endl;
+}
+
+void
+DBSelectCmd::help() const
+{
+   cout << setw(15) << left << "DBSElect: "
+        << "select the rows with a column in a range" << endl;
+}
+
+
 //----------------------------------------------------------------------
 //    DBSOrt <(int colIdx)>...
+//           [-Input (string csvFile) -Output (string csvFile)
+//            [-MemLimit (int MB)[K]]]
 //----------------------------------------------------------------------
 CmdExecStatus
 DBSortCmd::exec(const string& option)
@@ -483,13 +1454,75 @@ DBSortCmd::exec(const string& option)
    if (options.empty())
       return CmdExec::errorOption(CMD_OPT_MISSING, "");
 
-   DBSort sortOrders;
-   for (int i = 0, n = options.size(); i < n; ++i) {
+   // -Input/-Output: sort a csv file externally instead of the table
+   string inFile, outFile;
+   size_t memLimit = 0;
+   vector<string> cols;
+   for (size_t i = 0, n = options.size(); i < n; ++i) {
+      string* file = 0;
+      if (myStrNCmp("-Input", options[i], 2) == 0) file = &inFile;
+      else if (myStrNCmp("-Output", options[i], 2) == 0) file = &outFile;
+      else if (myStrNCmp("-MemLimit", options[i], 2) == 0) {
+         if (memLimit) return CmdExec::errorOption(CMD_OPT_EXTRA,options[i]);
+         if (++i == n)
+            return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
+         if (!str2MemLimit(options[i], memLimit))
+            return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+         continue;
+      }
+      else { cols.push_back(options[i]); continue; }
+      if (file->size()) return CmdExec::errorOption(CMD_OPT_EXTRA,options[i]);
+      if (++i == n)
+         return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
+      *file = options[i];
+   }
+   if (cols.empty() || inFile.empty() != outFile.empty())
+      return CmdExec::errorOption(CMD_OPT_MISSING, "");
+   if (memLimit && inFile.empty())
+      return CmdExec::errorOption(CMD_OPT_MISSING, "");
+
+   if (inFile.empty()) {
+      DBSort sortOrders;
+      for (size_t i = 0, n = cols.size(); i < n; ++i) {
+         int s;
+         if (!checkColIdx(cols[i], s)) return CMD_EXEC_ERROR;
+         sortOrders.pushOrder(s);
+      }
+      dbtbl.sort(sortOrders);
+      return CMD_EXEC_DONE;
+   }
+
+   vector<size_t> keys;
+   for (size_t i = 0, n = cols.size(); i < n; ++i) {
       int s;
-      if (!checkColIdx(options[i], s)) return CMD_EXEC_ERROR;
-      sortOrders.pushOrder(s);
+      if (!myStr2Int(cols[i], s)) {
+         cerr << "Error: " << cols[i] << " is not a number!!\n";
+         return CMD_EXEC_ERROR;
+      }
+      if (s < 0) {
+         cerr << "Error: Column index " << s << " is out of range!!\n";
+         return CMD_EXEC_ERROR;
+      }
+      keys.push_back(size_t(s));
+   }
+   if (!memLimit) memLimit = size_t(256) << 20;
+   DBExtSortStat st;
+   double t = wallClock();
+   bool ok = dbSortCsv(inFile, outFile, keys, memLimit, st);
+   t = wallClock() - t;
+   for (size_t i = 0; i < keys.size(); ++i)
+      if (st._nCols && keys[i] >= st._nCols) {
+         cerr << "Error: Column index " << keys[i] << " is out of range!!\n";
+         return CMD_EXEC_ERROR;
+      }
+   if (!ok) {
+      cerr << "Error: \"" << inFile << "\" cannot be sorted into \""
+           << outFile << "\"!!" << endl;
+      return CMD_EXEC_ERROR;
    }
-   dbtbl.sort(sortOrders);
+   cout << "\"" << inFile << "\" was sorted into \"" << outFile << "\" in "
+        << st._nRuns << " run" << (st._nRuns > 1? "s": "") << "." << endl;
+   printIOStat(st._nRows, st._nBytes, t);
 
    return CMD_EXEC_DONE;
 }
@@ -497,7 +1530,10 @@ DBSortCmd::exec(const string& option)
 void
 DBSortCmd::usage(ostream& os) const
 {
-   os << "Usage: DBSOrt <(int colIdx)>..." << endl;
+   os << "Usage: DBSOrt <(int colIdx)>..." << endl
+      << "              [-Input (string csvFile) -Output (string csvFile)"
+      << endl
+      << "               [-MemLimit (int MB)[K]]]" << endl;
 }
 
 void
@@ -519,10 +1555,14 @@ DBSumCmd::exec(const string& option)
    if (!CmdExec::lexSingleOption(option, token, false))
       return CMD_EXEC_ERROR;
    int c;
-   if (!checkColIdx(option, c)) return CMD_EXEC_ERROR;
+   if (!checkColIdx(token, c)) return CMD_EXEC_ERROR;
 
-   float n = dbtbl.getSum(c);
-   cout << "The sum of column " << c << " is " << n << "." << endl;
+   bool allNull;
+   long long n = dbtbl.getSum(c, allNull);
+   cout << "The sum of column " << c << " is ";
+   if (allNull) cout << float(NAN);
+   else cout << n;
+   cout << "." << endl;
 
    return CMD_EXEC_DONE;
 }
@@ -540,3 +1580,107 @@ DBSumCmd::help() const
         << "compute the summation of a column" << endl;
 }
 
+
+//----------------------------------------------------------------------
+//    DBTop <(int colIdx)> <(int k)>
+//----------------------------------------------------------------------
+// The rows of the k largest non-null cells of the column, largest first,
+// by a bounded heap instead of a sort of the table
+CmdExecStatus
+DBTopCmd::exec(const string& option)
+{
+   // check option
+   vector<string> options;
+   if (!CmdExec::lexOptions(option, options, 2))
+      return CMD_EXEC_ERROR;
+
+   int c, k;
+   if (!checkColIdx(options[0], c)) return CMD_EXEC_ERROR;
+   if (!myStr2Int(options[1], k) || k < 0)
+      return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[1]);
+
+   vector<uint32_t> rows;
+   double t = wallClock();
+   dbtbl.top(c, k, rows);
+   t = wallClock() - t;
+   for (size_t i = 0, n = rows.size(); i < n; ++i)
+      cout << DBRowView(dbtbl, rows[i]) << endl;
+   ios_base::fmtflags origFlags = cout.flags();
+   streamsize origPrec = cout.precision();
+   cout << "(" << rows.size() << " rows selected by a heap in " << fixed
+        << setprecision(2) << t * 1000 << " ms)" << endl;
+   cout.flags(origFlags);
+   cout.precision(origPrec);
+
+   return CMD_EXEC_DONE;
+}
+
+void
+DBTopCmd::usage(ostream& os) const
+{
+   os << "Usage: DBTop <(int colIdx)> <(int k)>" << endl;
+}
+
+void
+DBTopCmd::help() const
+{
+   cout << setw(15) << left << "DBTop: "
+        << "print the rows of the k largest data of a column" << endl;
+}
+
+
+//----------------------------------------------------------------------
+//    DBUse [(string tableName)]
+//----------------------------------------------------------------------
+CmdExecStatus
+DBUseCmd::exec(const string& option)
+{
+   // check option
+   string name;
+   if (!CmdExec::lexSingleOption(option, name))
+      return CMD_EXEC_ERROR;
+
+   if (name.empty()) {
+      map<string, const DBTable*> all;
+      all[dbCurName] = &dbtbl;
+      for (map<string, DBTable>::iterator it = dbCatalog.begin();
+           it != dbCatalog.end(); ++it)
+         all[it->first] = &it->second;
+      for (map<string, const DBTable*>::iterator it = all.begin();
+           it != all.end(); ++it)
+         cout << (it->first == dbCurName? "* ": "  ") << it->first << " ("
+              << it->second->nRows() << " rows, " << it->second->nCols()
+              << " columns)" << endl;
+      return CMD_EXEC_DONE;
+   }
+   if (name.find('.') != string::npos) {
+      cerr << "Error: Table name \"" << name << "\" contains '.'!!" << endl;
+      return CMD_EXEC_ERROR;
+   }
+   if (name == dbCurName) return CMD_EXEC_DONE;
+   // park the current table, and take 'name' (new if not in the catalog)
+   dbCatalog[dbCurName].swap(dbtbl);
+   map<string, DBTable>::iterator it = dbCatalog.find(name);
+   if (it == dbCatalog.end())
+      cout << "Table \"" << name << "\" is created..." << endl;
+   else {
+      dbtbl.swap(it->second);
+      dbCatalog.erase(it);
+   }
+   dbCurName = name;
+
+   return CMD_EXEC_DONE;
+}
+
+void
+DBUseCmd::usage(ostream& os) const
+{
+   os << "Usage: DBUse [(string tableName)]" << endl;
+}
+
+void
+DBUseCmd::help() const
+{
+   cout << setw(15) << left << "DBUse: "
+        << "switch to (or list) the named tables" << endl;
+}
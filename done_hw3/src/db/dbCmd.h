@@ -12,14 +12,26 @@
 
 CmdClass(DBAppendCmd);
 CmdClass(DBAveCmd);
+CmdClass(DBCompactCmd);
 CmdClass(DBCountCmd);
 CmdClass(DBDelCmd);
+CmdClass(DBFilterCmd);
+CmdClass(DBGroupCmd);
+CmdClass(DBIndexCmd);
+CmdClass(DBJoinCmd);
+CmdClass(DBLoadCmd);
 CmdClass(DBMaxCmd);
 CmdClass(DBMinCmd);
 CmdClass(DBPrintCmd);
+CmdClass(DBQuantileCmd);
 CmdClass(DBReadCmd);
+CmdClass(DBSaveCmd);
+CmdClass(DBScanCmd);
+CmdClass(DBSelectCmd);
 CmdClass(DBSortCmd);
 CmdClass(DBSumCmd);
+CmdClass(DBTopCmd);
+CmdClass(DBUseCmd);
 
 #endif // DB_CMD_H
 
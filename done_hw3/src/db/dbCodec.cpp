@@ -0,0 +1,217 @@
+/****************************************************************************
+  FileName     [ dbCodec.cpp ]
+  PackageName  [ db ]
+  Synopsis     [ Define the encodings of DBColumn ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2015-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+#include <algorithm>
+#include "dbTable.h"
+#include "dbCodec.h"
+#include "dbHash.h"
+
+using namespace std;
+
+// DB_ENC_DELTA keeps the running value at the start of every block of
+// DB_DELTA_ROWS rows, and its offset from there at the start of every
+// miniblock of DB_DELTA_MINI rows (packed in as few bits as the largest
+// one needs). So a cell is decoded from at most DB_DELTA_MINI deltas.
+#define DB_DELTA_BITS  7
+#define DB_DELTA_ROWS  (size_t(1) << DB_DELTA_BITS)
+#define DB_DELTA_MINI_BITS  3
+#define DB_DELTA_MINI  (size_t(1) << DB_DELTA_MINI_BITS)
+// DB_ENC_DICT is only tried up to this many distinct values
+#define DB_DICT_MAX    4096
+
+/*****************************************/
+/*  Member Functions for class DBColumn  */
+/*****************************************/
+// Pick the smallest of plain, frame of reference, delta (if the non-null
+// cells are non-decreasing, e.g. after DBSort) and dictionary (if there are
+// at most DB_DICT_MAX distinct values). A tie goes to the encoding with
+// the cheaper random access. The content, version and caches are kept.
+void
+DBColumn::encode()
+{
+   size_t n = _data.size();
+   if (_enc != DB_ENC_PLAIN || !n) return;
+   const DBColAgg& a = stats();
+   const int* d = _data.data();
+
+   DBColEncoding enc = DB_ENC_PLAIN;
+   size_t best = n * sizeof(int);
+   unsigned forBits =
+      a._count? dbBitWidth(uint64_t(int64_t(a._max) - a._min)): 0;
+   if (dbPackedBytes(n, forBits) < best) {
+      enc = DB_ENC_FOR;
+      best = dbPackedBytes(n, forBits);
+   }
+
+   vector<int> dict;
+   if (forBits > 1) {
+      DBIntHashSet hs;
+      for (size_t i = 0; i < n && dict.size() <= DB_DICT_MAX; ++i)
+         if (!isNull(i) && hs.insert(d[i])) dict.push_back(d[i]);
+      if (dict.size() <= DB_DICT_MAX) {
+         unsigned bits = dbBitWidth(dict.size() - 1);
+         size_t bytes = dbPackedBytes(n, bits) + dict.size() * sizeof(int);
+         if (bits < forBits && bytes < best) {
+            enc = DB_ENC_DICT;
+            best = bytes;
+         }
+      }
+   }
+
+   bool sorted = a._count > 0;
+   int prev = a._min, anchor = prev;
+   uint64_t maxDelta = 0, maxPrefix = 0;
+   for (size_t i = 0; i < n && sorted; ++i) {
+      if (!(i & (DB_DELTA_ROWS - 1))) anchor = prev;
+      else if (!(i & (DB_DELTA_MINI - 1)) &&
+               uint64_t(int64_t(prev) - anchor) > maxPrefix)
+         maxPrefix = uint64_t(int64_t(prev) - anchor);
+      if (isNull(i)) continue;
+      if (d[i] < prev) sorted = false;
+      else if (uint64_t(int64_t(d[i]) - prev) > maxDelta)
+         maxDelta = uint64_t(int64_t(d[i]) - prev);
+      prev = d[i];
+   }
+   unsigned deltaBits = dbBitWidth(maxDelta);
+   unsigned prefixBits = dbBitWidth(maxPrefix);
+   size_t nMini = (n + DB_DELTA_MINI - 1) >> DB_DELTA_MINI_BITS;
+   size_t deltaBytes = dbPackedBytes(n, deltaBits) +
+      ((n + DB_DELTA_ROWS - 1) >> DB_DELTA_BITS) * sizeof(int) +
+      dbPackedBytes(nMini, prefixBits);
+   if (sorted && deltaBits < forBits && deltaBytes < best) enc = DB_ENC_DELTA;
+
+   if (enc == DB_ENC_PLAIN) return;
+   vector<int> codes;
+   const int* packSrc = d;
+   if (enc == DB_ENC_FOR) {
+      _bits = forBits;
+      _base = a._min;
+   }
+   else if (enc == DB_ENC_DICT) {
+      std::sort(dict.begin(), dict.end());
+      _bits = dbBitWidth(dict.size() - 1);
+      _base = 0;
+      codes.assign(n, 0);
+      for (size_t i = 0; i < n; ++i)
+         if (!isNull(i))
+            codes[i] = int(lower_bound(dict.begin(), dict.end(), d[i])
+                           - dict.begin());
+      _aux.swap(dict);
+      packSrc = codes.data();
+   }
+   else {
+      // delta from the last non-null cell; the first one is the min
+      _bits = deltaBits;
+      _base = 0;
+      _aux.clear();
+      codes.assign(n, 0);
+      vector<int> prefix(nMini, 0);
+      uint32_t v = uint32_t(a._min);
+      for (size_t i = 0; i < n; ++i) {
+         if (!(i & (DB_DELTA_ROWS - 1))) _aux.push_back(int(v));
+         if (!(i & (DB_DELTA_MINI - 1)))
+            prefix[i >> DB_DELTA_MINI_BITS] = int(v - uint32_t(_aux.back()));
+         if (isNull(i)) continue;
+         codes[i] = int(uint32_t(d[i]) - v);
+         v = uint32_t(d[i]);
+      }
+      packSrc = codes.data();
+      // all the prefixes are valid
+      vector<uint64_t> all((nMini + 63) >> 6, ~uint64_t(0));
+      _prefixBits = prefixBits;
+      _prefix.assign(dbPackedBytes(nMini, prefixBits) >> 3, 0);
+      dbPack(prefix.data(), all.data(), nMini, 0, prefixBits, _prefix.data());
+   }
+   _packed.assign(dbPackedBytes(n, _bits) >> 3, 0);
+   dbPack(packSrc, _valid.data(), n, _base, _bits, _packed.data());
+   _enc = enc;
+   _nEnc = n;
+   vector<int> tmp; tmp.swap(_data);
+}
+
+void
+DBColumn::decode()
+{
+   if (_enc == DB_ENC_PLAIN) return;
+   vector<int> d(_nEnc);
+   decode(0, _nEnc, d.data());
+   d.swap(_data);
+   vector<uint64_t> packed; packed.swap(_packed);
+   vector<int> aux; aux.swap(_aux);
+   vector<uint64_t> prefix; prefix.swap(_prefix);
+   _enc = DB_ENC_PLAIN;
+   _nEnc = 0;
+}
+
+void
+DBColumn::decode(size_t b, size_t e, int* out) const
+{
+   const uint8_t* in = (const uint8_t*)_packed.data();
+   const uint64_t* valid = _valid.data();
+   switch (_enc) {
+      case DB_ENC_PLAIN:
+         copy(_data.begin() + b, _data.begin() + e, out);
+         break;
+      case DB_ENC_FOR:
+         dbUnpack(in, valid, b, e, _base, _bits, out);
+         break;
+      case DB_ENC_DICT:
+         for (size_t i = b; i < e; ++i) {
+            int v = _aux[dbFetch(in, i, _bits)];
+            out[i - b] = ((valid[i >> 6] >> (i & 63)) & 1)? v: INT_MAX;
+         }
+         break;
+      case DB_ENC_DELTA: {
+         size_t i = b & ~(DB_DELTA_MINI - 1);
+         uint32_t v = prefixAt(i);
+         for (; i < b; ++i) v += dbFetch(in, i, _bits);
+         for (; i < e; ++i) {
+            v += dbFetch(in, i, _bits);
+            out[i - b] = ((valid[i >> 6] >> (i & 63)) & 1)? int(v): INT_MAX;
+         }
+         break;
+      }
+   }
+}
+
+int
+DBColumn::decodeAt(size_t r) const
+{
+   if (isNull(r)) return INT_MAX;
+   const uint8_t* in = (const uint8_t*)_packed.data();
+   switch (_enc) {
+      case DB_ENC_FOR:
+         return int(uint32_t(_base) + dbFetch(in, r, _bits));
+      case DB_ENC_DICT:
+         return _aux[dbFetch(in, r, _bits)];
+      case DB_ENC_DELTA: {
+         size_t i = r & ~(DB_DELTA_MINI - 1);
+         uint32_t v = prefixAt(i);
+         for (; i <= r; ++i) v += dbFetch(in, i, _bits);
+         return int(v);
+      }
+      default:
+         return _data[r];
+   }
+}
+
+// DB_ENC_DELTA: the running value before cell #i, the start of a miniblock
+uint32_t
+DBColumn::prefixAt(size_t i) const
+{
+   return uint32_t(_aux[i >> DB_DELTA_BITS]) +
+      dbFetch((const uint8_t*)_prefix.data(), i >> DB_DELTA_MINI_BITS,
+              _prefixBits);
+}
+
+size_t
+DBColumn::cellBytes() const
+{
+   if (_enc == DB_ENC_PLAIN) return _data.size() * sizeof(int);
+   return (_packed.size() + _prefix.size()) * sizeof(uint64_t) +
+      _aux.size() * sizeof(int);
+}
@@ -0,0 +1,70 @@
+/****************************************************************************
+  FileName     [ dbCodec.h ]
+  PackageName  [ db ]
+  Synopsis     [ Define integer encoding helpers (frame of reference, ...) ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2015-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+#ifndef DB_CODEC_H
+#define DB_CODEC_H
+
+#include <cstring>
+#include <climits>
+#include <stdint.h>
+
+using namespace std;
+
+// #rows decoded at a time by the block-wise scans of encoded columns
+#define DB_DECODE_ROWS  1024
+
+// #bits to hold any value in [0, range]; 0 if range == 0
+inline unsigned dbBitWidth(uint64_t range)
+{
+   return range? 64 - unsigned(__builtin_clzll(range)): 0;
+}
+
+// #bytes of n values packed in 'bits' bits each. There are 8 more bytes
+// than needed, so that dbUnpack() can always read 8 bytes at once.
+inline size_t dbPackedBytes(size_t n, unsigned bits)
+{
+   return (((n * bits + 63) >> 6) + 1) << 3;
+}
+
+// Frame of reference + bit packing: value #i is (d[i] - base), stored in
+// bits [i * bits, (i + 1) * bits) of the little-endian 64-bit words 'out',
+// which must hold dbPackedBytes(n, bits) zeroed bytes. Null cells (i.e.
+// bit i of 'valid' is 0) are stored as 0.
+inline void dbPack(const int* d, const uint64_t* valid, size_t n, int base,
+                   unsigned bits, uint64_t* out)
+{
+   if (!bits) return;
+   for (size_t i = 0; i < n; ++i) {
+      if (!((valid[i >> 6] >> (i & 63)) & 1)) continue;
+      uint64_t v = uint32_t(d[i]) - uint32_t(base);
+      size_t pos = i * bits, w = pos >> 6, off = pos & 63;
+      out[w] |= v << off;
+      if (off + bits > 64) out[w + 1] |= v >> (64 - off);
+   }
+}
+
+// Value #i packed in 'bits' (<= 32) bits, by one unaligned 8-byte load
+inline uint32_t dbFetch(const uint8_t* in, size_t i, unsigned bits)
+{
+   size_t pos = i * bits;
+   uint64_t x;
+   memcpy(&x, in + (pos >> 3), 8);
+   return uint32_t((x >> (pos & 7)) & ((uint64_t(1) << bits) - 1));
+}
+
+// Inverse of dbPack() for values [b, e); null cells are restored as INT_MAX.
+// The loop has no branch, so a block is decoded at a few cycles per value.
+inline void dbUnpack(const uint8_t* in, const uint64_t* valid, size_t b,
+                     size_t e, int base, unsigned bits, int* d)
+{
+   for (size_t i = b; i < e; ++i) {
+      int v = int(uint32_t(base) + dbFetch(in, i, bits));
+      d[i - b] = ((valid[i >> 6] >> (i & 63)) & 1)? v: INT_MAX;
+   }
+}
+
+#endif // DB_CODEC_H
@@ -0,0 +1,305 @@
+/****************************************************************************
+  FileName     [ dbExtSort.cpp ]
+  PackageName  [ db ]
+  Synopsis     [ Define the external merge sort of csv files ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2015-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+#include <cstdio>
+#include <fstream>
+#include <algorithm>
+#include <vector>
+#include "dbReader.h"
+#include "dbFormat.h"
+
+using namespace std;
+
+// Max #runs merged at once (each one is an open temporary file)
+#define DB_SORT_FANIN  256
+
+// The order of DBSort on the key columns; nulls (INT_MAX) go last
+static inline bool
+rowLess(const int* a, const int* b, const vector<size_t>& keys)
+{
+   for (size_t i = 0, n = keys.size(); i < n; ++i)
+      if (a[keys[i]] != b[keys[i]]) return a[keys[i]] < b[keys[i]];
+   return false;
+}
+
+//----------------------------------------------------------------------
+//    DBRunReader: buffered sequential reader of a binary run file
+//----------------------------------------------------------------------
+// A run is a sequence of sorted rows of nCols int's each.
+class DBRunReader
+{
+public:
+   DBRunReader(FILE* f, size_t nCols, size_t nBufRows)
+      : _f(f), _nCols(nCols), _buf(nBufRows * nCols), _pos(0), _n(0) {
+      rewind(_f); fill(); }
+
+   bool done() const { return _pos == _n; }
+   const int* row() const { return &_buf[_pos * _nCols]; }
+   void next() { if (++_pos == _n) fill(); }
+   bool ok() const { return !ferror(_f); }
+
+private:
+   FILE*         _f;
+   size_t        _nCols;
+   vector<int>   _buf;
+   size_t        _pos;
+   size_t        _n;
+
+   void fill() {
+      _pos = 0;
+      _n = fread(_buf.data(), _nCols * sizeof(int), _buf.size() / _nCols, _f);
+   }
+};
+
+//----------------------------------------------------------------------
+//    DBLoserTree: tournament tree for the k-way merge
+//----------------------------------------------------------------------
+// Node #n (1 <= n < k) keeps the loser of the match played there, and
+// leaf #s is at node #(s + k); _winner is the overall winner. After the
+// winner advances, only the matches on its path to the root are replayed,
+// i.e. log2(k) comparisons per row. A tie goes to the lower run, so the
+// merge is stable.
+class DBLoserTree
+{
+public:
+   DBLoserTree(vector<DBRunReader>& runs, const vector<size_t>& keys)
+      : _runs(runs), _keys(keys), _loser(runs.size(), 0) {
+      _winner = build(1); }
+
+   bool done() const { return _runs[_winner].done(); }
+   const int* top() const { return _runs[_winner].row(); }
+   void pop() {
+      size_t w = _winner, k = _runs.size();
+      _runs[w].next();
+      for (size_t n = (w + k) >> 1; n >= 1; n >>= 1)
+         if (beats(_loser[n], w)) swap(_loser[n], w);
+      _winner = w;
+   }
+
+private:
+   vector<DBRunReader>&    _runs;
+   const vector<size_t>&   _keys;
+   vector<size_t>          _loser;
+   size_t                  _winner;
+
+   bool beats(size_t a, size_t b) const {
+      if (_runs[a].done()) return false;
+      if (_runs[b].done()) return true;
+      if (rowLess(_runs[a].row(), _runs[b].row(), _keys)) return true;
+      if (rowLess(_runs[b].row(), _runs[a].row(), _keys)) return false;
+      return a < b;
+   }
+   size_t build(size_t n) {
+      size_t k = _runs.size();
+      if (n >= k) return n - k;
+      size_t a = build(2 * n), b = build(2 * n + 1);
+      if (beats(a, b)) { _loser[n] = b; return a; }
+      _loser[n] = a;
+      return b;
+   }
+};
+
+/*****************************************/
+/*          Static Functions             */
+/*****************************************/
+// Sort order[0, n), the indices of rows in ascending order, on the key
+// columns keys[level...] of 'rows'. The (key, index) pairs are sorted as
+// 64-bit words, which is stable, and then every range of ties is sorted
+// the same way on the next key.
+static void
+sortRows(const int* rows, size_t nCols, const vector<size_t>& keys,
+         size_t level, uint32_t* order, uint64_t* words, size_t n)
+{
+   size_t k = keys[level];
+   for (size_t i = 0; i < n; ++i)
+      words[i] = (uint64_t(uint32_t(rows[order[i] * nCols + k]) ^ 0x80000000u)
+                  << 32) | order[i];
+   std::sort(words, words + n);
+   for (size_t i = 0; i < n; ++i) order[i] = uint32_t(words[i]);
+   if (level + 1 == keys.size()) return;
+   for (size_t b = 0, e; b < n; b = e) {
+      for (e = b + 1; e < n && (words[e] >> 32) == (words[b] >> 32); ++e) ;
+      if (e - b > 1)
+         sortRows(rows, nCols, keys, level + 1, order + b, words + b, e - b);
+   }
+}
+
+static void
+writeCsvRow(DBFormatter& f, const int* row, size_t nCols)
+{
+   for (size_t c = 0; c < nCols; ++c) {
+      if (c) f.put(',');
+      if (row[c] != INT_MAX) f.putInt(row[c]);
+   }
+   f.put('\n');
+}
+
+// Merge 'runs' (closed afterwards) in 'memBudget' bytes of buffers, and
+// pass the rows in order to 'out'
+template <class Out> static bool
+mergeRuns(const vector<FILE*>& runs, size_t nCols,
+          const vector<size_t>& keys, size_t memBudget, Out out)
+{
+   size_t nBufRows = memBudget / (runs.size() * nCols * sizeof(int));
+   if (!nBufRows) nBufRows = 1;
+   vector<DBRunReader> readers;
+   readers.reserve(runs.size());
+   for (size_t i = 0, n = runs.size(); i < n; ++i)
+      readers.push_back(DBRunReader(runs[i], nCols, nBufRows));
+   if (readers.size() == 1)
+      for (; !readers[0].done(); readers[0].next()) out(readers[0].row());
+   else
+      for (DBLoserTree t(readers, keys); !t.done(); t.pop()) out(t.top());
+   bool ok = true;
+   for (size_t i = 0, n = runs.size(); i < n; ++i) {
+      if (!readers[i].ok()) ok = false;
+      fclose(runs[i]);
+   }
+   return ok;
+}
+
+/*****************************************/
+/*          Global Functions             */
+/*****************************************/
+// External merge sort: the csv file is streamed in rows of nCols int's
+// into a buffer of 'memBudget' bytes; every time it is full, the rows are
+// sorted and written to a temporary run file. Whenever DB_SORT_FANIN runs
+// are open, they are merged by a loser tree into one run, so the number of
+// open files stays bounded; the last merge writes 'outFile' as csv. If all
+// the rows fit in one run, no temporary file is used at all.
+// As in DBTable::readCsv(), the first line decides #columns (missing cells
+// are nulls); the sort stops right there if any key is out of range.
+bool
+dbSortCsv(const string& inFile, const string& outFile,
+          const vector<size_t>& keys, size_t memBudget, DBExtSortStat& st)
+{
+   st = DBExtSortStat();
+   vector<int> rows;
+   vector<uint32_t> order;
+   vector<FILE*> runs;
+   size_t cap = 0;   // #rows per run
+   bool ok = true;
+   // sort the buffered rows by their indices (see sortRows())
+   vector<uint64_t> words;
+   auto sortRun = [&]() {
+      words.resize(order.size());
+      sortRows(rows.data(), st._nCols, keys, 0, order.data(), words.data(),
+               order.size());
+   };
+   // merge all the runs into one, so that at most DB_SORT_FANIN are open;
+   // the buffer of rows is freed meanwhile for the buffers of the merge
+   auto collapse = [&]() {
+      FILE* g = tmpfile();
+      if (!g) { ok = false; return; }
+      size_t nc = st._nCols;
+      vector<int>().swap(rows);
+      vector<uint64_t>().swap(words);
+      ok = mergeRuns(runs, nc, keys, memBudget, [&](const int* row) {
+         if (fwrite(row, sizeof(int), nc, g) != nc) ok = false; }) && ok;
+      runs.assign(1, g);
+      if (ok) rows.resize(cap * nc);
+   };
+   // sort the buffered rows into a new run; the buffer is emptied even if
+   // the run cannot be written
+   auto spill = [&]() {
+      sortRun();
+      FILE* f = tmpfile();
+      if (f) {
+         runs.push_back(f);
+         ++st._nRuns;
+         size_t nc = st._nCols;
+         for (size_t i = 0, n = order.size(); ok && i < n; ++i)
+            if (fwrite(&rows[order[i] * nc], sizeof(int), nc, f) != nc)
+               ok = false;
+      }
+      else ok = false;
+      order.clear();
+      if (ok && runs.size() == DB_SORT_FANIN) collapse();
+   };
+   // a new row of nulls in the buffer; 0 if the buffer cannot be spilled
+   auto newRow = [&]() -> int* {
+      if (order.size() == cap) {
+         spill();
+         if (!ok) return 0;
+      }
+      size_t r = order.size(), nc = st._nCols;
+      int* row = &rows[r * nc];
+      fill(row, row + nc, INT_MAX);
+      order.push_back(uint32_t(r));
+      ++st._nRows;
+      return row;
+   };
+   bool inRange = true;
+   size_t nLead = 0;   // empty lines before #columns is known
+   if (!dbStreamCsv(inFile, [&](const char* p, const char* e) {
+      while (p < e && ok) {
+         const char* q = dbEmptyLineEnd(p, e);
+         if (q != p) {  // a row of nulls in a 1-column file
+            p = q;
+            if (!st._nCols) ++nLead;
+            else if (st._nCols == 1 && !newRow()) break;
+            continue;
+         }
+         if (!st._nCols) {
+            const char* next;
+            st._nCols = dbCountCells(p, dbLineEnd(p, e, next));
+            for (size_t i = 0; i < keys.size(); ++i)
+               if (keys[i] >= st._nCols) return inRange = false;
+            cap = memBudget / (st._nCols * sizeof(int) + sizeof(uint32_t)
+                               + sizeof(uint64_t));
+            if (!cap) cap = 1;
+            rows.resize(cap * st._nCols);
+            order.reserve(cap);
+            for (; st._nCols == 1 && nLead && newRow(); --nLead) ;
+            if (!ok) break;
+         }
+         int* row = newRow();
+         if (!row) break;
+         size_t nc = st._nCols;
+         for (size_t c = 0; ; ++c) {
+            int d;
+            p = dbParseCell(p, e, d);
+            if (c < nc) row[c] = d;
+            if (p == e || *p != ',') break;
+            ++p;
+         }
+         if (p < e && *p == '\r') ++p;
+         if (p < e && *p == '\n') ++p;
+      }
+      return ok;
+   }, st._nBytes) || !ok || !inRange) {
+      for (size_t i = 0; i < runs.size(); ++i) fclose(runs[i]);
+      return false;
+   }
+
+   ofstream ofs(outFile.c_str());
+   if (!ofs) {
+      for (size_t i = 0; i < runs.size(); ++i) fclose(runs[i]);
+      return false;
+   }
+   size_t nc = st._nCols;
+   DBFormatter f(ofs);
+   if (runs.empty()) {  // an in-memory sort
+      sortRun();
+      for (size_t i = 0, n = order.size(); i < n; ++i)
+         writeCsvRow(f, &rows[order[i] * nc], nc);
+      st._nRuns = order.size()? 1: 0;
+      f.flush();
+      return bool(ofs);
+   }
+   if (order.size()) spill();
+   vector<int>().swap(rows);
+   vector<uint64_t>().swap(words);
+   if (!ok) {
+      for (size_t i = 0; i < runs.size(); ++i) fclose(runs[i]);
+      return false;
+   }
+   ok = mergeRuns(runs, nc, keys, memBudget, [&](const int* row) {
+      writeCsvRow(f, row, nc); });
+   f.flush();
+   return ok && bool(ofs);
+}
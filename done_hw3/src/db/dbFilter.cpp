@@ -0,0 +1,499 @@
+/****************************************************************************
+  FileName     [ dbFilter.cpp ]
+  PackageName  [ db ]
+  Synopsis     [ Define the vectorized filter expressions of DBTable ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2015-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <cctype>
+#include <cerrno>
+#include <strings.h>
+#include <algorithm>
+#include <functional>
+#include "dbTable.h"
+#include "dbFilter.h"
+#include "dbCodec.h"
+
+using namespace std;
+
+//----------------------------------------------------------------------
+//    DBFilterBlock: the rows [b, e) of a table under evaluation
+//----------------------------------------------------------------------
+// The cells of an operand column are decoded at most once per block, on
+// the first use (so the right side of a failed '&&' decodes nothing).
+// A block never crosses a zone, as DB_ZONE_ROWS is a multiple of
+// DB_DECODE_ROWS.
+class DBFilterBlock
+{
+public:
+   DBFilterBlock(const DBTable& t, const vector<size_t>& cols)
+      : _t(t), _cols(cols), _buf(cols.size() * DB_DECODE_ROWS),
+        _d(cols.size(), (const int*)0), _b(0), _n(0) {}
+
+   void reset(size_t b, size_t e) {
+      _b = b; _n = e - b;
+      fill(_d.begin(), _d.end(), (const int*)0);
+   }
+   size_t size() const { return _n; }
+   const DBColumn& col(size_t s) const { return _t.getCol(_cols[s]); }
+   // cells of slot #s, indexed by the offset in the block
+   const int* cells(size_t s) {
+      if (!_d[s])
+         _d[s] = col(s).cells(_b, _b + _n, _buf.data() + s * DB_DECODE_ROWS);
+      return _d[s];
+   }
+   // validity bitmap of slot #s from the first row of the block
+   const uint64_t* validity(size_t s) const {
+      return col(s).validity() + (_b >> 6); }
+   const DBZone& zone(size_t s, size_t& nRows) const {
+      const DBColumn& c = col(s);
+      size_t z = _b >> DB_ZONE_BITS;
+      nRows = c.zoneEnd(z) - c.zoneBegin(z);
+      return c.zone(z);
+   }
+
+private:
+   const DBTable&          _t;
+   const vector<size_t>&   _cols;
+   vector<int>             _buf;
+   vector<const int*>      _d;
+   size_t                  _b;
+   size_t                  _n;
+};
+
+static inline bool
+isValid(const uint64_t* v, uint32_t i)
+{
+   return (v[i >> 6] >> (i & 63)) & 1;
+}
+
+// out = sel \ a, where a is a subset of sel; both are increasing. 'out'
+// may be 'sel'.
+static size_t
+selectDiff(const uint32_t* sel, size_t n, const uint32_t* a, size_t na,
+           uint32_t* out)
+{
+   size_t k = 0, j = 0;
+   for (size_t i = 0; i < n; ++i) {
+      if (j < na && a[j] == sel[i]) { ++j; continue; }
+      out[k++] = sel[i];
+   }
+   return k;
+}
+
+//----------------------------------------------------------------------
+//    DBFilterNode and the operators
+//----------------------------------------------------------------------
+// eval() keeps the rows of sel[0, n) (offsets in the block, increasing)
+// that satisfy the node, in order, and returns how many are kept. 'out'
+// may be 'sel', so a row is always written at or before the position it
+// is read from. If n == blk.size(), sel[] is all the rows of the block,
+// and the leaves may run the dense kernels.
+class DBFilterNode
+{
+public:
+   virtual ~DBFilterNode() {}
+   virtual size_t eval(DBFilterBlock& blk, const uint32_t* sel, size_t n,
+                       uint32_t* out) const = 0;
+
+protected:
+   static size_t keepAll(const uint32_t* sel, size_t n, uint32_t* out) {
+      if (out != sel) copy(sel, sel + n, out);
+      return n;
+   }
+};
+
+// Non-null cells of slot #s in [lo, hi], or out of it if '_neg' (then
+// lo <= hi). The zone map decides the whole block when it can.
+class DBFilterRange : public DBFilterNode
+{
+public:
+   DBFilterRange(size_t s, int lo, int hi, bool neg)
+      : _s(s), _lo(lo), _hi(hi), _neg(neg) {}
+
+   size_t eval(DBFilterBlock& blk, const uint32_t* sel, size_t n,
+               uint32_t* out) const {
+      size_t zn;
+      const DBZone& z = blk.zone(_s, zn);
+      if (z._nNull == zn || _lo > _hi) return 0;
+      bool inside = _lo <= z._min && z._max <= _hi;
+      bool outside = z._max < _lo || z._min > _hi;
+      if (_neg? inside: outside) return 0;
+      if (!z._nNull && (_neg? outside: inside)) return keepAll(sel, n, out);
+      const int* d = blk.cells(_s);
+      const uint64_t* v = blk.validity(_s);
+      if (!_neg && n == blk.size())
+         return dbSelectRange(d, v, n, _lo, _hi, 0, out);
+      size_t k = 0;
+      for (size_t j = 0; j < n; ++j) {
+         uint32_t i = sel[j];
+         bool in = (d[i] >= _lo) & (d[i] <= _hi);
+         out[k] = i;
+         k += isValid(v, i) & (in != _neg);
+      }
+      return k;
+   }
+
+private:
+   size_t   _s;
+   int      _lo;
+   int      _hi;
+   bool     _neg;
+};
+
+// Null (or non-null if !_isNull) cells of slot #s
+class DBFilterNull : public DBFilterNode
+{
+public:
+   DBFilterNull(size_t s, bool isNull) : _s(s), _isNull(isNull) {}
+
+   size_t eval(DBFilterBlock& blk, const uint32_t* sel, size_t n,
+               uint32_t* out) const {
+      size_t zn;
+      const DBZone& z = blk.zone(_s, zn);
+      if (z._nNull == (_isNull? 0: zn)) return 0;
+      if (z._nNull == (_isNull? zn: 0)) return keepAll(sel, n, out);
+      const uint64_t* v = blk.validity(_s);
+      size_t k = 0;
+      for (size_t j = 0; j < n; ++j) {
+         out[k] = sel[j];
+         k += isValid(v, sel[j]) != _isNull;
+      }
+      return k;
+   }
+
+private:
+   size_t   _s;
+   bool     _isNull;
+};
+
+enum DBFilterOp
+{
+   DB_FILTER_LT,
+   DB_FILTER_LE,
+   DB_FILTER_GT,
+   DB_FILTER_GE,
+   DB_FILTER_EQ,
+   DB_FILTER_NE
+};
+
+// Compare two columns; both cells must be non-null
+class DBFilterCols : public DBFilterNode
+{
+public:
+   DBFilterCols(size_t s1, DBFilterOp op, size_t s2)
+      : _s1(s1), _s2(s2), _op(op) {}
+
+   size_t eval(DBFilterBlock& blk, const uint32_t* sel, size_t n,
+               uint32_t* out) const {
+      switch (_op) {
+         case DB_FILTER_LT: return cmp(blk, sel, n, out, less<int>());
+         case DB_FILTER_LE: return cmp(blk, sel, n, out, less_equal<int>());
+         case DB_FILTER_GT: return cmp(blk, sel, n, out, greater<int>());
+         case DB_FILTER_GE:
+            return cmp(blk, sel, n, out, greater_equal<int>());
+         case DB_FILTER_EQ: return cmp(blk, sel, n, out, equal_to<int>());
+         default:           return cmp(blk, sel, n, out, not_equal_to<int>());
+      }
+   }
+
+private:
+   size_t       _s1;
+   size_t       _s2;
+   DBFilterOp   _op;
+
+   template <class Cmp>
+   size_t cmp(DBFilterBlock& blk, const uint32_t* sel, size_t n,
+              uint32_t* out, Cmp c) const {
+      const int* a = blk.cells(_s1), *b = blk.cells(_s2);
+      const uint64_t* va = blk.validity(_s1), *vb = blk.validity(_s2);
+      size_t k = 0;
+      for (size_t j = 0; j < n; ++j) {
+         uint32_t i = sel[j];
+         out[k] = i;
+         k += isValid(va, i) & isValid(vb, i) & c(a[i], b[i]);
+      }
+      return k;
+   }
+};
+
+// The right side only sees the rows kept by the left side
+class DBFilterAnd : public DBFilterNode
+{
+public:
+   DBFilterAnd(DBFilterNode* l, DBFilterNode* r) : _l(l), _r(r) {}
+
+   size_t eval(DBFilterBlock& blk, const uint32_t* sel, size_t n,
+               uint32_t* out) const {
+      size_t k = _l->eval(blk, sel, n, out);
+      return k? _r->eval(blk, out, k, out): 0;
+   }
+
+private:
+   DBFilterNode*   _l;
+   DBFilterNode*   _r;
+};
+
+// The right side only sees the rows rejected by the left side; the two
+// results are then merged in order
+class DBFilterOr : public DBFilterNode
+{
+public:
+   DBFilterOr(DBFilterNode* l, DBFilterNode* r) : _l(l), _r(r) {}
+
+   size_t eval(DBFilterBlock& blk, const uint32_t* sel, size_t n,
+               uint32_t* out) const {
+      uint32_t a[DB_DECODE_ROWS], b[DB_DECODE_ROWS];
+      size_t na = _l->eval(blk, sel, n, a);
+      if (na == n) return keepAll(sel, n, out);
+      size_t nb = selectDiff(sel, n, a, na, b);
+      nb = _r->eval(blk, b, nb, b);
+      return merge(a, a + na, b, b + nb, out) - out;
+   }
+
+private:
+   DBFilterNode*   _l;
+   DBFilterNode*   _r;
+};
+
+class DBFilterNot : public DBFilterNode
+{
+public:
+   DBFilterNot(DBFilterNode* c) : _c(c) {}
+
+   size_t eval(DBFilterBlock& blk, const uint32_t* sel, size_t n,
+               uint32_t* out) const {
+      uint32_t a[DB_DECODE_ROWS];
+      size_t na = _c->eval(blk, sel, n, a);
+      return selectDiff(sel, n, a, na, out);
+   }
+
+private:
+   DBFilterNode*   _c;
+};
+
+//----------------------------------------------------------------------
+//    DBFilterParser: recursive descent into DBFilterNode's
+//----------------------------------------------------------------------
+//    or      := and ("||" and)*
+//    and     := unary ("&&" unary)*
+//    unary   := "!" unary | "(" or ")" | operand op operand
+//    operand := c<colIdx> | <int> | null
+//    op      := "<" | "<=" | ">" | ">=" | "==" | "=" | "!="
+// Double quotes are ignored, so the expression may be quoted.
+class DBFilterParser
+{
+public:
+   DBFilterParser(const string& s, size_t nCols, DBFilter& f)
+      : _s(s), _p(0), _nCols(nCols), _f(f) {}
+
+   DBFilterNode* parse(string& err) {
+      DBFilterNode* n = parseOr();
+      if (n && !atEnd()) n = fail("Illegal filter expression at \"" +
+                                  _s.substr(_p) + "\"");
+      err = _err;
+      return n;
+   }
+
+private:
+   enum OperandType { DB_OPND_COL, DB_OPND_INT, DB_OPND_NULL };
+   struct Operand {
+      OperandType   _type;
+      long long     _val;   // colIdx or the constant
+   };
+
+   const string&   _s;
+   size_t          _p;
+   size_t          _nCols;
+   DBFilter&       _f;
+   string          _err;
+
+   void skip() {
+      while (_p < _s.size() && (isspace(_s[_p]) || _s[_p] == '"')) ++_p; }
+   bool atEnd() { skip(); return _p == _s.size(); }
+   // consume 'tok' if it is next
+   bool accept(const char* tok) {
+      skip();
+      size_t n = strlen(tok);
+      if (_s.compare(_p, n, tok) != 0) return false;
+      _p += n;
+      return true;
+   }
+   DBFilterNode* fail(const string& err) {
+      if (_err.empty()) _err = err;
+      return 0;
+   }
+   DBFilterNode* add(DBFilterNode* n) { _f._nodes.push_back(n); return n; }
+   DBFilterNode* failHere() {
+      if (atEnd()) return fail("Missing operand at the end of the filter");
+      return fail("Illegal filter expression at \"" + _s.substr(_p) + "\"");
+   }
+
+   DBFilterNode* parseOr() {
+      DBFilterNode* n = parseAnd();
+      while (n && accept("||")) {
+         DBFilterNode* r = parseAnd();
+         n = r? add(new DBFilterOr(n, r)): 0;
+      }
+      return n;
+   }
+   DBFilterNode* parseAnd() {
+      DBFilterNode* n = parseUnary();
+      while (n && accept("&&")) {
+         DBFilterNode* r = parseUnary();
+         n = r? add(new DBFilterAnd(n, r)): 0;
+      }
+      return n;
+   }
+   DBFilterNode* parseUnary() {
+      skip();
+      if (_s.compare(_p, 2, "!=") != 0 && accept("!")) {
+         DBFilterNode* c = parseUnary();
+         return c? add(new DBFilterNot(c)): 0;
+      }
+      if (accept("(")) {
+         DBFilterNode* n = parseOr();
+         if (n && !accept(")")) return fail("Missing \")\" in the filter");
+         return n;
+      }
+      return parseCmp();
+   }
+   bool parseOperand(Operand& o) {
+      skip();
+      size_t b = _p;
+      if (_p < _s.size() && tolower(_s[_p]) == 'c' && _p + 1 < _s.size() &&
+          isdigit(_s[_p + 1])) {
+         o._type = DB_OPND_COL;
+         o._val = 0;
+         for (++_p; _p < _s.size() && isdigit(_s[_p]); ++_p)
+            if ((o._val = o._val * 10 + (_s[_p] - '0')) > INT_MAX)
+               o._val = INT_MAX;
+         if (size_t(o._val) >= _nCols) {
+            fail("Column index " + _s.substr(b + 1, _p - b - 1) +
+                 " is out of range");
+            return false;
+         }
+         return true;
+      }
+      if (_s.size() - _p >= 4 && strncasecmp(&_s[_p], "null", 4) == 0 &&
+          (_p + 4 == _s.size() || !isalnum(_s[_p + 4]))) {
+         o._type = DB_OPND_NULL;
+         _p += 4;
+         return true;
+      }
+      const char* p = _s.c_str() + _p;
+      char* e;
+      errno = 0;
+      o._val = strtoll(p, &e, 10);
+      if (e == p || isalnum(*e)) { failHere(); return false; }
+      if (errno || o._val < INT_MIN || o._val >= INT_MAX) {
+         fail(_s.substr(_p, e - p) + " is out of the range of data");
+         return false;
+      }
+      o._type = DB_OPND_INT;
+      _p += e - p;
+      return true;
+   }
+   bool parseOp(DBFilterOp& op) {
+      if (accept("<=")) op = DB_FILTER_LE;
+      else if (accept(">=")) op = DB_FILTER_GE;
+      else if (accept("==") || accept("=")) op = DB_FILTER_EQ;
+      else if (accept("!=")) op = DB_FILTER_NE;
+      else if (accept("<")) op = DB_FILTER_LT;
+      else if (accept(">")) op = DB_FILTER_GT;
+      else { failHere(); return false; }
+      return true;
+   }
+   // c op k is mapped to a range of non-null cells; (k op c) is (c op' k)
+   DBFilterNode* parseCmp() {
+      Operand a, b;
+      DBFilterOp op;
+      if (!parseOperand(a) || !parseOp(op) || !parseOperand(b)) return 0;
+      if (a._type != DB_OPND_COL) {
+         static const DBFilterOp flip[] = { DB_FILTER_GT, DB_FILTER_GE,
+            DB_FILTER_LT, DB_FILTER_LE, DB_FILTER_EQ, DB_FILTER_NE };
+         swap(a, b);
+         op = flip[op];
+      }
+      if (a._type != DB_OPND_COL)
+         return fail("A comparison in the filter needs a column");
+      size_t s = slot(a._val);
+      if (b._type == DB_OPND_COL)
+         return add(new DBFilterCols(s, op, slot(b._val)));
+      if (b._type == DB_OPND_NULL) {
+         if (op != DB_FILTER_EQ && op != DB_FILTER_NE)
+            return fail("null can only be compared by \"==\" or \"!=\"");
+         return add(new DBFilterNull(s, op == DB_FILTER_EQ));
+      }
+      long long lo = INT_MIN, hi = INT_MAX, k = b._val;
+      switch (op) {
+         case DB_FILTER_LT: hi = k - 1; break;
+         case DB_FILTER_LE: hi = k; break;
+         case DB_FILTER_GT: lo = k + 1; break;
+         case DB_FILTER_GE: lo = k; break;
+         default:           lo = hi = k; break;
+      }
+      if (lo > hi) lo = 1, hi = 0;   // k - 1 underflows: nothing matches
+      return add(new DBFilterRange(s, int(lo), int(hi), op == DB_FILTER_NE));
+   }
+   // the operand slot of column #c, shared by all its occurrences
+   size_t slot(long long c) {
+      vector<size_t>& cols = _f._cols;
+      size_t s = find(cols.begin(), cols.end(), size_t(c)) - cols.begin();
+      if (s == cols.size()) cols.push_back(size_t(c));
+      return s;
+   }
+};
+
+/*****************************************/
+/*  Member Functions for class DBFilter  */
+/*****************************************/
+bool
+DBFilter::compile(const string& expr, size_t nCols, string& err)
+{
+   clear();
+   DBFilterParser p(expr, nCols, *this);
+   _root = p.parse(err);
+   if (!_root) { clear(); return false; }
+   return true;
+}
+
+void
+DBFilter::clear()
+{
+   for (size_t i = 0, n = _nodes.size(); i < n; ++i) delete _nodes[i];
+   _nodes.clear();
+   _cols.clear();
+   _root = 0;
+}
+
+/*****************************************/
+/*   Member Functions for class DBTable  */
+/*****************************************/
+// Rows (physical, in order) of the live rows that satisfy 'f'. The table
+// is evaluated DB_DECODE_ROWS rows at a time: the selection vector of a
+// block starts with its live rows and is narrowed by the operators.
+void
+DBTable::filter(const DBFilter& f, vector<uint32_t>& rows) const
+{
+   rows.clear();
+   if (f.empty()) return;
+   const bool anyDead = _dead.size() > 0;
+   DBFilterBlock blk(*this, f._cols);
+   uint32_t sel[DB_DECODE_ROWS];
+   for (size_t b = 0; b < _nRows; b += DB_DECODE_ROWS) {
+      size_t e = min(b + DB_DECODE_ROWS, _nRows), n = 0;
+      for (size_t i = b; i < e; ++i) {
+         sel[n] = uint32_t(i - b);
+         n += !(anyDead && _dead.isDead(i));
+      }
+      blk.reset(b, e);
+      n = f._root->eval(blk, sel, n, sel);
+      size_t k = rows.size();
+      rows.resize(k + n);
+      for (size_t i = 0; i < n; ++i) rows[k + i] = uint32_t(b) + sel[i];
+   }
+}
@@ -0,0 +1,50 @@
+/****************************************************************************
+  FileName     [ dbFilter.h ]
+  PackageName  [ db ]
+  Synopsis     [ Define the filter expressions of DBTable ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2015-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+#ifndef DB_FILTER_H
+#define DB_FILTER_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class DBFilterNode;   // see dbFilter.cpp
+
+// A filter expression compiled into a tree of column operators, e.g.
+//    c2 > 10 && (c5 != null || !(c0 == c1))
+// Operands are columns (c<colIdx>), int constants and null; a comparison
+// needs at least one column. A comparison with a null cell is false, and
+// '!' is the complement, so "!(c2 > 10)" also keeps the nulls of c2.
+// "== null" and "!= null" test for nulls. '&&' binds tighter than '||'.
+// The tree is evaluated by DBTable::filter() over blocks of rows (see
+// dbFilter.cpp).
+class DBFilter
+{
+public:
+   DBFilter() : _root(0) {}
+   ~DBFilter() { clear(); }
+
+   // false with the reason in 'err' if 'expr' is illegal for a table of
+   // 'nCols' columns
+   bool compile(const string& expr, size_t nCols, string& err);
+   bool empty() const { return _root == 0; }
+
+private:
+   friend class DBTable;
+   friend class DBFilterParser;
+
+   DBFilterNode*            _root;
+   vector<DBFilterNode*>    _nodes;   // all the nodes, for deletion
+   vector<size_t>           _cols;    // the column of every operand slot
+
+   DBFilter(const DBFilter&);              // not copyable
+   DBFilter& operator = (const DBFilter&);
+   void clear();
+};
+
+#endif // DB_FILTER_H
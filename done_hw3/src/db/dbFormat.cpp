@@ -0,0 +1,69 @@
+/****************************************************************************
+  FileName     [ dbFormat.cpp ]
+  PackageName  [ db ]
+  Synopsis     [ Define the buffered text formatter for printing tables ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2015-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+#include <cstring>
+#include <stdint.h>
+#include "dbFormat.h"
+
+using namespace std;
+
+// "00", "01", ..., "99": two digits are produced per division
+static const char dbDigitPairs[] =
+   "00010203040506070809101112131415161718192021222324252627282930313233"
+   "34353637383940414243444546474849505152535455565758596061626364656667"
+   "6869707172737475767778798081828384858687888990919293949596979899";
+
+/*****************************************/
+/*          Static Functions             */
+/*****************************************/
+// Write the decimal digits of 'd' backwards, ending right before 'e';
+// return the first char
+static char*
+formatInt(int d, char* e)
+{
+   uint32_t u = d < 0? 0u - uint32_t(d): uint32_t(d);
+   while (u >= 100) {
+      const char* p = dbDigitPairs + (u % 100) * 2;
+      u /= 100;
+      *--e = p[1];
+      *--e = p[0];
+   }
+   if (u >= 10) {
+      *--e = dbDigitPairs[u * 2 + 1];
+      *--e = dbDigitPairs[u * 2];
+   }
+   else *--e = char('0' + u);
+   if (d < 0) *--e = '-';
+   return e;
+}
+
+/*****************************************/
+/* Member Functions for class DBFormatter*/
+/*****************************************/
+void
+DBFormatter::putInt(int d)
+{
+   char tmp[16];
+   char* e = tmp + sizeof(tmp), *b = formatInt(d, e);
+   reserve(e - b);
+   memcpy(_buf + _n, b, e - b);
+   _n += e - b;
+}
+
+void
+DBFormatter::putCell(int d, size_t width)
+{
+   char tmp[16];
+   char* e = tmp + sizeof(tmp), *b = e;
+   if (d == INT_MAX) *--b = '.';
+   else b = formatInt(d, e);
+   size_t len = e - b, pad = width > len? width - len: 0;
+   reserve(pad + len);
+   memset(_buf + _n, ' ', pad);
+   memcpy(_buf + _n + pad, b, len);
+   _n += pad + len;
+}
@@ -0,0 +1,42 @@
+/****************************************************************************
+  FileName     [ dbFormat.h ]
+  PackageName  [ db ]
+  Synopsis     [ Define the buffered text formatter for printing tables ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2015-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+#ifndef DB_FORMAT_H
+#define DB_FORMAT_H
+
+#include <iostream>
+#include <climits>
+
+using namespace std;
+
+// #chars buffered before they are written to the stream
+#define DB_FORMAT_BUF  (1 << 16)
+
+// Render cells as text into a char buffer, which is handed over to the
+// stream by one write() whenever it is full (and at the end), instead of
+// going through the iostream formatting and flushing per cell.
+class DBFormatter
+{
+public:
+   DBFormatter(ostream& os) : _os(os), _n(0) {}
+   ~DBFormatter() { flush(); _os.flush(); }
+
+   void put(char c) { reserve(1); _buf[_n++] = c; }
+   void putInt(int d);
+   // 'd' right-aligned in 'width' chars as by setw(); '.' for a null
+   void putCell(int d, size_t width = 0);
+   void flush() { if (_n) { _os.write(_buf, _n); _n = 0; } }
+
+private:
+   ostream&   _os;
+   size_t     _n;
+   char       _buf[DB_FORMAT_BUF];
+
+   void reserve(size_t n) { if (_n + n > DB_FORMAT_BUF) flush(); }
+};
+
+#endif // DB_FORMAT_H
@@ -0,0 +1,175 @@
+/****************************************************************************
+  FileName     [ dbGroup.cpp ]
+  PackageName  [ db ]
+  Synopsis     [ Define the hash group-by aggregation of DBTable ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2015-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+#include <algorithm>
+#include <queue>
+#include "dbTable.h"
+#include "dbCodec.h"
+#include "dbHash.h"
+#include "dbThread.h"
+
+using namespace std;
+
+// Below this many rows, one thread aggregates the whole table
+#define DB_GROUP_PAR_ROWS  (1 << 20)
+// #partitions of the parallel mode, by the top bits of the key hash
+#define DB_GROUP_PART_BITS 6
+#define DB_GROUP_PARTS     (1 << DB_GROUP_PART_BITS)
+
+//----------------------------------------------------------------------
+//    DBGroupTable: open addressing from a key to its DBGroup
+//----------------------------------------------------------------------
+// The key is stored in the slot together with its aggregate, so a probe
+// and the update touch the same cache line. INT_MAX marks an empty slot;
+// the null key is kept aside in _null.
+class DBGroupTable
+{
+public:
+   DBGroupTable() : _size(0), _hasNull(false) { init(0); }
+
+   DBColAgg& operator [] (int k) {
+      if (k == INT_MAX) return _null._agg;
+      size_t i = dbHashInt(k) & _mask;
+      while (_slots[i]._key != k) {
+         if (_slots[i]._key == INT_MAX) {
+            if ((_size + 1) * 2 > _slots.size()) {
+               rehash(_size + 1);
+               return (*this)[k];
+            }
+            _slots[i]._key = k;
+            ++_size;
+            break;
+         }
+         i = (i + 1) & _mask;
+      }
+      return _slots[i]._agg;
+   }
+   void add(int k, int d, bool valid) {
+      DBColAgg& a = (*this)[k];
+      if (k == INT_MAX) _hasNull = true;
+      if (!valid) return;
+      ++a._count;
+      a._sum += d;
+      if (d < a._min) a._min = d;
+      if (d > a._max) a._max = d;
+   }
+   void merge(const DBGroupTable& t) {
+      for (size_t i = 0, n = t._slots.size(); i < n; ++i)
+         if (t._slots[i]._key != INT_MAX)
+            (*this)[t._slots[i]._key].merge(t._slots[i]._agg);
+      if (t._hasNull) { _hasNull = true; _null._agg.merge(t._null._agg); }
+   }
+   // append the groups (but the null one) to 'g', in no particular order
+   void collect(vector<DBGroup>& g) const {
+      for (size_t i = 0, n = _slots.size(); i < n; ++i)
+         if (_slots[i]._key != INT_MAX) g.push_back(_slots[i]);
+   }
+   bool hasNull() const { return _hasNull; }
+   const DBGroup& nullGroup() const { return _null; }
+
+private:
+   vector<DBGroup>   _slots;
+   size_t            _mask;
+   size_t            _size;
+   DBGroup           _null;
+   bool              _hasNull;
+
+   void init(size_t n) {
+      size_t cap = 16;
+      while (cap < n * 2) cap <<= 1;
+      _slots.assign(cap, DBGroup());
+      _mask = cap - 1;
+   }
+   void rehash(size_t n) {
+      vector<DBGroup> old;
+      old.swap(_slots);
+      init(n < _size * 2? _size * 2: n);
+      for (size_t i = 0, m = old.size(); i < m; ++i)
+         if (old[i]._key != INT_MAX) {
+            size_t j = dbHashInt(old[i]._key) & _mask;
+            while (_slots[j]._key != INT_MAX) j = (j + 1) & _mask;
+            _slots[j] = old[i];
+         }
+   }
+};
+
+static inline size_t
+groupPart(int k)
+{
+   return k == INT_MAX? 0: size_t(dbHashInt(k) >> (64 - DB_GROUP_PART_BITS));
+}
+
+/*****************************************/
+/*   Member Functions for class DBTable  */
+/*****************************************/
+// Aggregate column #ac per distinct value of column #kc into 'groups', in
+// the increasing order of the keys; the group of null keys, if any, is the
+// last one (with _key == INT_MAX). Null cells of #ac are not aggregated.
+// A large table is cut into one range of rows per thread; every thread
+// aggregates its rows into DB_GROUP_PARTS tables by the hash of the key,
+// and then each partition is merged over the threads independently.
+// The deleted rows are skipped (their cells are nulls, but they are not to
+// be counted in the group of null keys).
+void
+DBTable::group(size_t kc, size_t ac, vector<DBGroup>& groups,
+               size_t nThreads) const
+{
+   groups.clear();
+   const DBColumn& kcol = _cols[kc], &acol = _cols[ac];
+   const bool anyDead = _dead.size() > 0;
+   if (_nRows < DB_GROUP_PAR_ROWS) nThreads = 1;
+   size_t nParts = nThreads > 1? DB_GROUP_PARTS: 1;
+   vector<vector<DBGroupTable> > local(nThreads,
+                                       vector<DBGroupTable>(nParts));
+   dbParallelFor(nThreads, nThreads, [&](size_t t) {
+      size_t rb = (_nRows * t / nThreads) & ~size_t(63);
+      size_t re = t + 1 == nThreads? _nRows:
+                  (_nRows * (t + 1) / nThreads) & ~size_t(63);
+      int kbuf[DB_DECODE_ROWS], abuf[DB_DECODE_ROWS];
+      vector<DBGroupTable>& parts = local[t];
+      for (size_t b = rb; b < re; b += DB_DECODE_ROWS) {
+         size_t e = min(b + DB_DECODE_ROWS, re);
+         const int* k = kcol.cells(b, e, kbuf), *d = acol.cells(b, e, abuf);
+         for (size_t i = b; i < e; ++i) {
+            if (anyDead && _dead.isDead(i)) continue;
+            int key = k[i - b];
+            DBGroupTable& g = parts[nParts > 1? groupPart(key): 0];
+            g.add(key, d[i - b], !acol.isNull(i));
+         }
+      }
+   });
+   vector<vector<DBGroup> > out(nParts);
+   vector<DBGroup> nulls(nParts);
+   vector<char> hasNull(nParts, 0);
+   dbParallelFor(nParts, nThreads, [&](size_t p) {
+      DBGroupTable& g = local[0][p];
+      for (size_t t = 1; t < nThreads; ++t) g.merge(local[t][p]);
+      g.collect(out[p]);
+      std::sort(out[p].begin(), out[p].end(),
+                [](const DBGroup& a, const DBGroup& b) {
+                   return a._key < b._key; });
+      if (g.hasNull()) { nulls[p] = g.nullGroup(); hasNull[p] = 1; }
+   });
+   // k-way merge of the sorted partitions by a min-heap of their heads
+   typedef pair<int, size_t> Head;  // (key, partition)
+   priority_queue<Head, vector<Head>, greater<Head> > heads;
+   vector<size_t> pos(nParts, 0);
+   size_t n = 0;
+   for (size_t p = 0; p < nParts; ++p) {
+      n += out[p].size();
+      if (out[p].size()) heads.push(Head(out[p][0]._key, p));
+   }
+   groups.reserve(n + 1);
+   while (!heads.empty()) {
+      size_t p = heads.top().second;
+      heads.pop();
+      groups.push_back(out[p][pos[p]++]);
+      if (pos[p] < out[p].size()) heads.push(Head(out[p][pos[p]]._key, p));
+   }
+   for (size_t p = 0; p < nParts; ++p)
+      if (hasNull[p]) { groups.push_back(nulls[p]); break; }
+}
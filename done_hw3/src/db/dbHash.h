@@ -0,0 +1,124 @@
+/****************************************************************************
+  FileName     [ dbHash.h ]
+  PackageName  [ db ]
+  Synopsis     [ Define integer hash set and HyperLogLog sketch ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2015-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+#ifndef DB_HASH_H
+#define DB_HASH_H
+
+#include <vector>
+#include <cmath>
+#include <climits>
+#include <stdint.h>
+
+using namespace std;
+
+// 64-bit finalizer of MurmurHash3; cheap and mixes all the input bits.
+inline uint64_t dbHashInt(int k)
+{
+   uint64_t h = uint64_t(uint32_t(k));
+   h ^= h >> 33; h *= 0xff51afd7ed558ccdULL;
+   h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ULL;
+   h ^= h >> 33;
+   return h;
+}
+
+//----------------------------------------------------------------------
+//    DBIntHashSet: open addressing with linear probing
+//----------------------------------------------------------------------
+// INT_MAX (i.e. the null cell) marks an empty slot and cannot be inserted.
+// The capacity is a power of 2 and kept at most half full, so probing
+// sequences stay short and stay within one or two cache lines.
+class DBIntHashSet
+{
+public:
+   DBIntHashSet(size_t n = 0) : _size(0) { init(n); }
+
+   void reserve(size_t n) { if (n * 2 > _slots.size()) rehash(n); }
+   size_t size() const { return _size; }
+
+   // return true if 'k' is newly inserted
+   bool insert(int k) {
+      if ((_size + 1) * 2 > _slots.size()) rehash(_size + 1);
+      size_t i = dbHashInt(k) & _mask;
+      while (_slots[i] != INT_MAX) {
+         if (_slots[i] == k) return false;
+         i = (i + 1) & _mask;
+      }
+      _slots[i] = k;
+      ++_size;
+      return true;
+   }
+   bool contains(int k) const {
+      size_t i = dbHashInt(k) & _mask;
+      while (_slots[i] != INT_MAX) {
+         if (_slots[i] == k) return true;
+         i = (i + 1) & _mask;
+      }
+      return false;
+   }
+
+private:
+   vector<int>   _slots;
+   size_t        _mask;
+   size_t        _size;
+
+   void init(size_t n) {
+      size_t cap = 16;
+      while (cap < n * 2) cap <<= 1;
+      _slots.assign(cap, INT_MAX);
+      _mask = cap - 1;
+   }
+   void rehash(size_t n) {
+      vector<int> old;
+      old.swap(_slots);
+      init(n < _size * 2? _size * 2: n);
+      _size = 0;
+      for (size_t i = 0, m = old.size(); i < m; ++i)
+         if (old[i] != INT_MAX) insert(old[i]);
+   }
+};
+
+//----------------------------------------------------------------------
+//    DBHyperLogLog: approximate distinct counting in 2^p bytes
+//----------------------------------------------------------------------
+class DBHyperLogLog
+{
+public:
+   DBHyperLogLog(unsigned p = 14) : _p(p), _reg(size_t(1) << p, 0) {}
+
+   void add(int k) {
+      uint64_t h = dbHashInt(k);
+      size_t idx = h >> (64 - _p);
+      uint64_t rest = (h << _p) | (uint64_t(1) << (_p - 1)); // never 0
+      uint8_t rank = uint8_t(__builtin_clzll(rest) + 1);
+      if (rank > _reg[idx]) _reg[idx] = rank;
+   }
+   void merge(const DBHyperLogLog& s) {
+      for (size_t i = 0, m = _reg.size(); i < m; ++i)
+         if (s._reg[i] > _reg[i]) _reg[i] = s._reg[i];
+   }
+   double estimate() const {
+      double m = double(_reg.size()), sum = 0;
+      size_t zeros = 0;
+      for (size_t i = 0, n = _reg.size(); i < n; ++i) {
+         sum += ldexp(1.0, -int(_reg[i]));
+         if (!_reg[i]) ++zeros;
+      }
+      double e = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+      if (e <= 2.5 * m && zeros)  // small range: linear counting
+         e = m * log(m / double(zeros));
+      return e;
+   }
+   // standard error of the estimate
+   double relError() const { return 1.04 / sqrt(double(_reg.size())); }
+   size_t memBytes() const { return _reg.size(); }
+
+private:
+   unsigned          _p;
+   vector<uint8_t>   _reg;
+};
+
+#endif // DB_HASH_H
@@ -0,0 +1,123 @@
+/****************************************************************************
+  FileName     [ dbIndex.cpp ]
+  PackageName  [ db ]
+  Synopsis     [ Define the secondary index and range selection of DBTable ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2015-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+#include <algorithm>
+#include "dbTable.h"
+#include "dbCodec.h"
+#include "dbHash.h"
+
+using namespace std;
+
+/*****************************************/
+/*   Member Functions for class DBTable  */
+/*****************************************/
+void
+DBTable::buildIndex(size_t c)
+{
+   _cols[c]._index._on = true;
+   refreshIndex(c);
+}
+
+// (Re)build the index of column #c if the column has changed since. The
+// (value, row) pairs are sorted as 64-bit keys, with the sign bit of the
+// value flipped so that the unsigned order is the int order.
+void
+DBTable::refreshIndex(size_t c) const
+{
+   const DBColumn& col = _cols[c];
+   DBColIndex& idx = col._index;
+   if (idx._version == col.version()) return;
+   vector<uint64_t> keys;
+   keys.reserve(col.stats()._count);
+   int buf[DB_DECODE_ROWS];
+   for (size_t b = 0; b < _nRows; b += DB_DECODE_ROWS) {
+      size_t e = min(b + DB_DECODE_ROWS, _nRows);
+      const int* d = col.cells(b, e, buf);
+      for (size_t i = b; i < e; ++i)
+         if (!col.isNull(i))
+            keys.push_back((uint64_t(uint32_t(d[i - b]) ^ 0x80000000u) << 32)
+                           | i);
+   }
+   std::sort(keys.begin(), keys.end());
+   size_t n = keys.size();
+   idx._keys.resize(n);
+   idx._rows.resize(n);
+   for (size_t i = 0; i < n; ++i) {
+      idx._keys[i] = int(uint32_t(keys[i] >> 32) ^ 0x80000000u);
+      idx._rows[i] = uint32_t(keys[i]);
+   }
+   idx._version = col.version();
+}
+
+// Rows of the non-null cells of column #c in [lo, hi], in row order.
+// With an index, the range is found by binary search; otherwise the zones
+// that miss [lo, hi] are skipped and the others are scanned by the
+// vectorized range kernel (block by block if the column is encoded).
+// Return true if the index is used.
+bool
+DBTable::select(size_t c, int lo, int hi, vector<uint32_t>& rows) const
+{
+   rows.clear();
+   if (lo > hi) return hasIndex(c);
+   const DBColumn& col = _cols[c];
+   if (col.hasIndex()) {
+      refreshIndex(c);
+      const DBColIndex& idx = col._index;
+      size_t b = lower_bound(idx._keys.begin(), idx._keys.end(), lo)
+                 - idx._keys.begin();
+      size_t e = upper_bound(idx._keys.begin() + b, idx._keys.end(), hi)
+                 - idx._keys.begin();
+      rows.assign(idx._rows.begin() + b, idx._rows.begin() + e);
+      std::sort(rows.begin(), rows.end());
+      return true;
+   }
+   int buf[DB_DECODE_ROWS];
+   for (size_t z = 0, nz = col.nZones(); z < nz; ++z) {
+      const DBZone& zn = col.zone(z);
+      size_t zb = col.zoneBegin(z), ze = col.zoneEnd(z);
+      if (zn._nNull == ze - zb || zn._max < lo || zn._min > hi) continue;
+      size_t k = rows.size();
+      if (!zn._nNull && lo <= zn._min && zn._max <= hi) {  // all match
+         rows.resize(k + ze - zb);
+         for (size_t i = zb; i < ze; ++i) rows[k++] = uint32_t(i);
+         continue;
+      }
+      rows.resize(k + ze - zb);
+      for (size_t b = zb; b < ze; b += DB_DECODE_ROWS) {
+         size_t e = min(b + DB_DECODE_ROWS, ze);
+         k += dbSelectRange(col.cells(b, e, buf), col.validity() + (b >> 6),
+                            e - b, lo, hi, uint32_t(b), rows.data() + k);
+      }
+      rows.resize(k);
+   }
+   return false;
+}
+
+// Aggregate the cells of column #c in 'rows' (e.g. from select())
+void
+DBTable::aggregate(size_t c, const vector<uint32_t>& rows, DBColAgg& a) const
+{
+   const DBColumn& col = _cols[c];
+   for (size_t i = 0, n = rows.size(); i < n; ++i) {
+      if (col.isNull(rows[i])) continue;
+      int d = col[rows[i]];
+      ++a._count;
+      a._sum += d;
+      if (d < a._min) a._min = d;
+      if (d > a._max) a._max = d;
+   }
+}
+
+size_t
+DBTable::countDistinct(size_t c, const vector<uint32_t>& rows) const
+{
+   const DBColumn& col = _cols[c];
+   DBIntHashSet hs;
+   for (size_t i = 0, n = rows.size(); i < n; ++i)
+      if (!col.isNull(rows[i])) hs.insert(col[rows[i]]);
+   return hs.size();
+}
@@ -0,0 +1,202 @@
+/****************************************************************************
+  FileName     [ dbJoin.cpp ]
+  PackageName  [ db ]
+  Synopsis     [ Define the radix-partitioned hash join of DBTable ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2015-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+#include <cstdio>
+#include <algorithm>
+#include "dbTable.h"
+#include "dbCodec.h"
+#include "dbHash.h"
+
+using namespace std;
+
+#define DB_JOIN_MIN_PARTS  64
+#define DB_JOIN_MAX_PARTS  4096
+// Max #pairs buffered per partition before being written to its spill file
+#define DB_JOIN_FLUSH      4096
+
+// A join key and its row in the input table
+struct DBJoinPair
+{
+   int        _key;
+   uint32_t   _row;
+};
+
+//----------------------------------------------------------------------
+//    DBJoinSide: the (key, row) pairs of one input, by partition
+//----------------------------------------------------------------------
+// In memory, each partition is a vector. When spilling, a partition keeps
+// fewer than 'flush' pairs in memory and appends the rest to its own
+// temporary file, which is deleted on close.
+class DBJoinSide
+{
+public:
+   DBJoinSide(size_t nParts, size_t flush)
+      : _parts(nParts), _files(flush? nParts: 0, (FILE*)0), _flush(flush),
+        _nSpilled(0), _ok(true) {}
+   ~DBJoinSide() {
+      for (size_t p = 0; p < _files.size(); ++p)
+         if (_files[p]) fclose(_files[p]);
+   }
+
+   void add(size_t p, const DBJoinPair& x) {
+      _parts[p].push_back(x);
+      if (_flush && _parts[p].size() >= _flush) flush(p);
+   }
+   // all the pairs of partition #p, in the input order
+   void read(size_t p, vector<DBJoinPair>& v) {
+      v.clear();
+      if (!_files.empty() && _files[p]) {
+         FILE* f = _files[p];
+         long n = ftell(f) / long(sizeof(DBJoinPair));
+         v.resize(size_t(n));
+         rewind(f);
+         if (fread(v.data(), sizeof(DBJoinPair), n, f) != size_t(n))
+            _ok = false;
+         fclose(f);
+         _files[p] = 0;
+      }
+      v.insert(v.end(), _parts[p].begin(), _parts[p].end());
+      vector<DBJoinPair> tmp; tmp.swap(_parts[p]);
+   }
+   size_t nSpilled() const { return _nSpilled; }
+   bool ok() const { return _ok; }
+
+private:
+   vector<vector<DBJoinPair> >  _parts;
+   vector<FILE*>                _files;
+   size_t                       _flush;
+   size_t                       _nSpilled;
+   bool                         _ok;
+
+   void flush(size_t p) {
+      if (!_files[p] && !(_files[p] = tmpfile())) { _ok = false; return; }
+      if (fwrite(_parts[p].data(), sizeof(DBJoinPair), _parts[p].size(),
+                 _files[p]) != _parts[p].size())
+         _ok = false;
+      _nSpilled += _parts[p].size() * sizeof(DBJoinPair);
+      _parts[p].clear();
+   }
+};
+
+/*****************************************/
+/*          Static Functions             */
+/*****************************************/
+// Add the (key, row) pairs of the non-null cells of 'col' to 's'; the
+// partition is given by the top 'bits' bits of the key hash.
+static void
+partition(const DBColumn& col, size_t n, unsigned bits, DBJoinSide& s)
+{
+   int buf[DB_DECODE_ROWS];
+   for (size_t b = 0; b < n; b += DB_DECODE_ROWS) {
+      size_t e = min(b + DB_DECODE_ROWS, n);
+      const int* d = col.cells(b, e, buf);
+      for (size_t i = b; i < e; ++i) {
+         if (col.isNull(i)) continue;
+         DBJoinPair x = { d[i - b], uint32_t(i) };
+         s.add(bits? size_t(dbHashInt(x._key) >> (64 - bits)): 0, x);
+      }
+   }
+}
+
+// Join one partition: a chained hash table is built on 'build' (head and
+// next indices in two arrays), and 'probe' is streamed through it. Every
+// match appends (row of 'a' << 32 | row of 'b') to 'out'.
+static void
+joinPartition(const vector<DBJoinPair>& build,
+              const vector<DBJoinPair>& probe, bool buildIsA,
+              vector<uint64_t>& out)
+{
+   if (build.empty() || probe.empty()) return;
+   size_t cap = 16;
+   while (cap < build.size() * 2) cap <<= 1;
+   const size_t mask = cap - 1;
+   const uint32_t none = uint32_t(-1);
+   vector<uint32_t> head(cap, none), next(build.size());
+   for (size_t i = 0, n = build.size(); i < n; ++i) {
+      size_t h = dbHashInt(build[i]._key) & mask;
+      next[i] = head[h];
+      head[h] = uint32_t(i);
+   }
+   for (size_t j = 0, m = probe.size(); j < m; ++j) {
+      int k = probe[j]._key;
+      for (uint32_t i = head[dbHashInt(k) & mask]; i != none; i = next[i]) {
+         if (build[i]._key != k) continue;
+         uint64_t ra = buildIsA? build[i]._row: probe[j]._row;
+         uint64_t rb = buildIsA? probe[j]._row: build[i]._row;
+         out.push_back((ra << 32) | rb);
+      }
+   }
+}
+
+/*****************************************/
+/*   Member Functions for class DBTable  */
+/*****************************************/
+// Replace this table by the inner equi-join of 'a' and 'b' on a.col #ac ==
+// b.col #bc: the columns of 'a' followed by those of 'b', one row per
+// matching pair, ordered by (row of 'a', row of 'b'). Null keys match
+// nothing.
+// Both inputs are radix-partitioned by the key hash into enough partitions
+// that the larger one takes at most 'memBudget' bytes per partition; the
+// side with fewer keys is the build side. If the pairs of the two sides
+// together exceed 'memBudget', the partitions are spilled to temporary
+// files and joined one at a time. 'nSpilled' returns #bytes written to them.
+// Return false if a temporary file cannot be written or read.
+bool
+DBTable::join(const DBTable& a, size_t ac, const DBTable& b, size_t bc,
+              size_t memBudget, size_t& nSpilled)
+{
+   const DBColumn& ka = a._cols[ac], &kb = b._cols[bc];
+   size_t na = ka.stats()._count, nb = kb.stats()._count;
+   size_t bytes = (na + nb) * sizeof(DBJoinPair);
+   size_t nParts = DB_JOIN_MIN_PARTS;
+   while (nParts < DB_JOIN_MAX_PARTS &&
+          max(na, nb) * sizeof(DBJoinPair) / nParts > memBudget)
+      nParts <<= 1;
+   unsigned bits = dbBitWidth(nParts - 1);
+   size_t flush = 0;
+   if (bytes > memBudget)   // the buffers of all partitions fit the budget
+      flush = max(size_t(1), min(size_t(DB_JOIN_FLUSH),
+                  memBudget / (2 * nParts * sizeof(DBJoinPair))));
+
+   DBJoinSide sa(nParts, flush), sb(nParts, flush);
+   partition(ka, a._nRows, bits, sa);
+   partition(kb, b._nRows, bits, sb);
+   bool buildIsA = na <= nb;
+   vector<uint64_t> pairs;
+   vector<DBJoinPair> pa, pb;
+   for (size_t p = 0; p < nParts; ++p) {
+      sa.read(p, pa);
+      sb.read(p, pb);
+      if (buildIsA) joinPartition(pa, pb, true, pairs);
+      else joinPartition(pb, pa, false, pairs);
+   }
+   nSpilled = sa.nSpilled() + sb.nSpilled();
+   if (!sa.ok() || !sb.ok()) return false;
+   std::sort(pairs.begin(), pairs.end());
+
+   size_t m = pairs.size(), nca = a._cols.size(), ncb = b._cols.size();
+   vector<DBColumn> cols(nca + ncb);
+   vector<int> d(m), plain;
+   for (size_t c = 0; c < nca + ncb; ++c) {
+      const DBColumn& src = c < nca? a._cols[c]: b._cols[c - nca];
+      const DBTable& t = c < nca? a: b;
+      unsigned shift = c < nca? 32: 0;
+      const int* s = src.data();
+      if (!src.isPlain()) {   // gather from the decoded cells
+         plain.resize(t._nRows);
+         src.decode(0, t._nRows, plain.data());
+         s = plain.data();
+      }
+      for (size_t i = 0; i < m; ++i)
+         d[i] = s[uint32_t(pairs[i] >> shift)];
+      cols[c] = DBColumn(d);
+   }
+   _cols.swap(cols);
+   _nRows = m;
+   _dead.reset();
+   return true;
+}
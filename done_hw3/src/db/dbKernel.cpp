@@ -0,0 +1,248 @@
+/****************************************************************************
+  FileName     [ dbKernel.cpp ]
+  PackageName  [ db ]
+  Synopsis     [ Define vectorized column kernels ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2015-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+#include "dbKernel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DB_X86_KERNEL
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+typedef void (*AggKernel)(const int*, const uint64_t*, size_t, DBColAgg&);
+typedef size_t (*RangeKernel)(const int*, const uint64_t*, size_t, int, int,
+                              uint32_t, uint32_t*);
+
+/*****************************************/
+/*          Static Functions             */
+/*****************************************/
+// Handles the rows [b, e) one by one; also used for the tails of the
+// vectorized kernels.
+static void
+aggScalar(const int* d, const uint64_t* valid, size_t b, size_t e,
+          DBColAgg& a)
+{
+   for (size_t i = b; i < e; ++i) {
+      uint64_t m = valid[i >> 6];
+      if (!m) { i |= 63; continue; }  // skip the whole null word
+      if (!((m >> (i & 63)) & 1)) continue;
+      ++a._count;
+      a._sum += d[i];
+      if (d[i] < a._min) a._min = d[i];
+      if (d[i] > a._max) a._max = d[i];
+   }
+}
+
+static void
+aggScalar(const int* d, const uint64_t* valid, size_t n, DBColAgg& a)
+{
+   aggScalar(d, valid, 0, n, a);
+}
+
+// Rows [b, e), branch-free: every row is written, but 'k' only advances
+// on a match.
+static size_t
+rangeScalar(const int* d, const uint64_t* valid, size_t b, size_t e, int lo,
+            int hi, uint32_t base, uint32_t* out)
+{
+   size_t k = 0;
+   for (size_t i = b; i < e; ++i) {
+      out[k] = base + uint32_t(i);
+      k += ((valid[i >> 6] >> (i & 63)) & 1) & (d[i] >= lo) & (d[i] <= hi);
+   }
+   return k;
+}
+
+static size_t
+rangeScalar(const int* d, const uint64_t* valid, size_t n, int lo, int hi,
+            uint32_t base, uint32_t* out)
+{
+   return rangeScalar(d, valid, 0, n, lo, hi, base, out);
+}
+
+#ifdef DB_X86_KERNEL
+// In both kernels, a bitmap word covers 64 rows. A full word needs no
+// masking; otherwise the 8 (or 4) bits of each vector are expanded to
+// lane masks, and null lanes are replaced by the identity of min/max/sum.
+__attribute__((target("avx2"))) static void
+aggAvx2(const int* d, const uint64_t* valid, size_t n, DBColAgg& a)
+{
+   const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+   const __m256i idMin = _mm256_set1_epi32(INT_MAX);
+   const __m256i idMax = _mm256_set1_epi32(INT_MIN);
+   __m256i vmin = idMin, vmax = idMax, vsum = _mm256_setzero_si256();
+   size_t nw = n >> 6;
+   for (size_t w = 0; w < nw; ++w) {
+      uint64_t m = valid[w];
+      if (!m) continue;
+      a._count += __builtin_popcountll(m);
+      const int* p = d + (w << 6);
+      if (m == ~uint64_t(0)) {
+         for (size_t k = 0; k < 64; k += 8) {
+            __m256i x = _mm256_loadu_si256((const __m256i*)(p + k));
+            vmin = _mm256_min_epi32(vmin, x);
+            vmax = _mm256_max_epi32(vmax, x);
+            vsum = _mm256_add_epi64(vsum,
+                   _mm256_cvtepi32_epi64(_mm256_castsi256_si128(x)));
+            vsum = _mm256_add_epi64(vsum,
+                   _mm256_cvtepi32_epi64(_mm256_extracti128_si256(x, 1)));
+         }
+         continue;
+      }
+      for (size_t k = 0; k < 64; k += 8, m >>= 8) {
+         int byte = int(m & 0xff);
+         if (!byte) continue;
+         __m256i mask = _mm256_cmpeq_epi32(
+                        _mm256_and_si256(_mm256_set1_epi32(byte), bits), bits);
+         __m256i x = _mm256_loadu_si256((const __m256i*)(p + k));
+         vmin = _mm256_min_epi32(vmin, _mm256_blendv_epi8(idMin, x, mask));
+         vmax = _mm256_max_epi32(vmax, _mm256_blendv_epi8(idMax, x, mask));
+         x = _mm256_and_si256(x, mask);
+         vsum = _mm256_add_epi64(vsum,
+                _mm256_cvtepi32_epi64(_mm256_castsi256_si128(x)));
+         vsum = _mm256_add_epi64(vsum,
+                _mm256_cvtepi32_epi64(_mm256_extracti128_si256(x, 1)));
+      }
+   }
+   int mins[8], maxs[8];
+   long long sums[4];
+   _mm256_storeu_si256((__m256i*)mins, vmin);
+   _mm256_storeu_si256((__m256i*)maxs, vmax);
+   _mm256_storeu_si256((__m256i*)sums, vsum);
+   for (size_t i = 0; i < 8; ++i) {
+      if (mins[i] < a._min) a._min = mins[i];
+      if (maxs[i] > a._max) a._max = maxs[i];
+   }
+   a._sum += sums[0] + sums[1] + sums[2] + sums[3];
+   aggScalar(d, valid, nw << 6, n, a);
+}
+
+__attribute__((target("sse4.1"))) static void
+aggSse41(const int* d, const uint64_t* valid, size_t n, DBColAgg& a)
+{
+   const __m128i bits = _mm_setr_epi32(1, 2, 4, 8);
+   const __m128i idMin = _mm_set1_epi32(INT_MAX);
+   const __m128i idMax = _mm_set1_epi32(INT_MIN);
+   __m128i vmin = idMin, vmax = idMax, vsum = _mm_setzero_si128();
+   size_t nw = n >> 6;
+   for (size_t w = 0; w < nw; ++w) {
+      uint64_t m = valid[w];
+      if (!m) continue;
+      a._count += __builtin_popcountll(m);
+      const int* p = d + (w << 6);
+      bool full = (m == ~uint64_t(0));
+      for (size_t k = 0; k < 64; k += 4, m >>= 4) {
+         int nib = int(m & 0xf);
+         if (!nib) continue;
+         __m128i x = _mm_loadu_si128((const __m128i*)(p + k));
+         if (!full) {
+            __m128i mask = _mm_cmpeq_epi32(
+                           _mm_and_si128(_mm_set1_epi32(nib), bits), bits);
+            vmin = _mm_min_epi32(vmin, _mm_blendv_epi8(idMin, x, mask));
+            vmax = _mm_max_epi32(vmax, _mm_blendv_epi8(idMax, x, mask));
+            x = _mm_and_si128(x, mask);
+         }
+         else {
+            vmin = _mm_min_epi32(vmin, x);
+            vmax = _mm_max_epi32(vmax, x);
+         }
+         vsum = _mm_add_epi64(vsum, _mm_cvtepi32_epi64(x));
+         vsum = _mm_add_epi64(vsum, _mm_cvtepi32_epi64(_mm_srli_si128(x, 8)));
+      }
+   }
+   int mins[4], maxs[4];
+   long long sums[2];
+   _mm_storeu_si128((__m128i*)mins, vmin);
+   _mm_storeu_si128((__m128i*)maxs, vmax);
+   _mm_storeu_si128((__m128i*)sums, vsum);
+   for (size_t i = 0; i < 4; ++i) {
+      if (mins[i] < a._min) a._min = mins[i];
+      if (maxs[i] > a._max) a._max = maxs[i];
+   }
+   a._sum += sums[0] + sums[1];
+   aggScalar(d, valid, nw << 6, n, a);
+}
+// lo <= x <= hi iff max(x, lo) == min(x, hi); the 8 lane results are ANDed
+// with the validity bits, and the set bits are extracted one by one.
+__attribute__((target("avx2"))) static size_t
+rangeAvx2(const int* d, const uint64_t* valid, size_t n, int lo, int hi,
+          uint32_t base, uint32_t* out)
+{
+   const __m256i vlo = _mm256_set1_epi32(lo), vhi = _mm256_set1_epi32(hi);
+   size_t k = 0, n8 = n & ~size_t(7);
+   for (size_t i = 0; i < n8; i += 8) {
+      unsigned m = unsigned(valid[i >> 6] >> (i & 63)) & 0xff;
+      if (!m) continue;
+      __m256i x = _mm256_loadu_si256((const __m256i*)(d + i));
+      __m256i in = _mm256_cmpeq_epi32(_mm256_max_epi32(x, vlo),
+                                      _mm256_min_epi32(x, vhi));
+      m &= unsigned(_mm256_movemask_ps(_mm256_castsi256_ps(in)));
+      for (; m; m &= m - 1)
+         out[k++] = base + uint32_t(i + __builtin_ctz(m));
+   }
+   return k + rangeScalar(d, valid, n8, n, lo, hi, base, out + k);
+}
+#endif // DB_X86_KERNEL
+
+static AggKernel
+selectKernel(const char*& name)
+{
+#ifdef DB_X86_KERNEL
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2")) { name = "avx2"; return aggAvx2; }
+   if (__builtin_cpu_supports("sse4.1")) { name = "sse4.1"; return aggSse41; }
+#endif
+   name = "scalar";
+   return aggScalar;
+}
+
+static RangeKernel
+selectRangeKernel()
+{
+#ifdef DB_X86_KERNEL
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2")) return rangeAvx2;
+#endif
+   return rangeScalar;
+}
+
+static const char*  kernelName = 0;
+static AggKernel    aggKernel = selectKernel(kernelName);
+static RangeKernel  rangeKernel = selectRangeKernel();
+
+/*****************************************/
+/*          Global Functions             */
+/*****************************************/
+void
+dbAggregate(const int* d, const uint64_t* valid, size_t n, DBColAgg& a)
+{
+   aggKernel(d, valid, n, a);
+}
+
+size_t
+dbSelectRange(const int* d, const uint64_t* valid, size_t n, int lo, int hi,
+              uint32_t base, uint32_t* out)
+{
+   return rangeKernel(d, valid, n, lo, hi, base, out);
+}
+
+const char*
+dbKernelName()
+{
+   return kernelName;
+}
+
+bool
+dbOptimized()
+{
+#ifdef __OPTIMIZE__
+   return true;
+#else
+   return false;
+#endif
+}
@@ -0,0 +1,50 @@
+/****************************************************************************
+  FileName     [ dbKernel.h ]
+  PackageName  [ db ]
+  Synopsis     [ Define vectorized column kernels ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2015-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+#ifndef DB_KERNEL_H
+#define DB_KERNEL_H
+
+#include <cstddef>
+#include <climits>
+#include <stdint.h>
+
+using namespace std;
+
+// Partial aggregate of a column. Kernels accumulate into it, so the
+// results of several blocks (or columns segments) can be merged.
+struct DBColAgg
+{
+   DBColAgg() : _count(0), _sum(0), _min(INT_MAX), _max(INT_MIN) {}
+
+   void merge(const DBColAgg& a) {
+      _count += a._count; _sum += a._sum;
+      if (a._min < _min) _min = a._min;
+      if (a._max > _max) _max = a._max;
+   }
+
+   size_t      _count;   // number of non-null cells
+   long long   _sum;     // 64-bit, so that int columns never overflow
+   int         _min;
+   int         _max;
+};
+
+// Aggregate the non-null cells among d[0, n). Bit (i % 64) of valid[i / 64]
+// is set iff d[i] is not null; the content of null cells does not matter.
+// The AVX2/SSE4.1/scalar kernel is picked once at run time.
+extern void dbAggregate(const int* d, const uint64_t* valid, size_t n,
+                        DBColAgg& a);
+extern const char* dbKernelName();
+// Whether the db package was compiled with optimization (see dbBench)
+extern bool dbOptimized();
+
+// Append (base + i) to 'out' for every non-null d[i] in [lo, hi], i in
+// [0, n), in increasing order; 'out' must have room for n entries. Return
+// #entries written.
+extern size_t dbSelectRange(const int* d, const uint64_t* valid, size_t n,
+                            int lo, int hi, uint32_t base, uint32_t* out);
+
+#endif // DB_KERNEL_H
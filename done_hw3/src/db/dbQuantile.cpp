@@ -0,0 +1,230 @@
+/****************************************************************************
+  FileName     [ dbQuantile.cpp ]
+  PackageName  [ db ]
+  Synopsis     [ Define the top-k and quantile queries of DBTable ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2015-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+#include <cmath>
+#include <algorithm>
+#include "dbTable.h"
+
+using namespace std;
+
+// Capacity of the top compactor of DBKllSketch, and the least of any one
+#define DB_KLL_K  200
+#define DB_KLL_M  8
+
+//----------------------------------------------------------------------
+//    DBKllSketch: KLL quantile sketch of a stream of int's
+//----------------------------------------------------------------------
+// Level #h keeps items of weight w * 2^h. When the sketch is full, the
+// lowest level at its capacity is sorted, and every other item (from a
+// random offset) is promoted to the next level; the rest are dropped. The
+// top level holds up to k items and every level below 2/3 of the one
+// above. A level that would get fewer than DB_KLL_M is folded into the
+// sampler instead, which doubles w: one item of every w comes in, picked
+// by reservoir sampling, so most items cost no comparison at all. So the
+// memory is O(k), and the total weight is always #items added. The min
+// and the max are kept aside, so that the 0- and 1-quantiles are exact.
+class DBKllSketch
+{
+public:
+   DBKllSketch(size_t k = DB_KLL_K)
+      : _k(k), _size(0), _cap(0), _rand(0x9e3779b97f4a7c15ULL),
+        _min(INT_MAX), _max(INT_MIN), _w(1), _nBlock(0), _pick(0) { grow(); }
+
+   void add(int d) {
+      if (d < _min) _min = d;
+      if (d > _max) _max = d;
+      // replace the pick with the probability of 1 / (#items in the block)
+      if (((next() >> 32) * ++_nBlock) >> 32 == 0) _pick = d;
+      if (_nBlock < _w) return;
+      _nBlock = 0;
+      _levels[0].push_back(_pick);
+      if (++_size >= _cap) compress();
+   }
+   // nearest-rank quantiles of the items added; 'n' must be #items
+   void quantiles(const vector<double>& p, size_t n, vector<int>& q) const;
+   // the normalized rank error (empirical, with 99% confidence)
+   double rankError() const { return 2.296 / pow(double(_k), 0.9723); }
+
+private:
+   size_t                  _k;
+   size_t                  _size;     // #items in the levels
+   size_t                  _cap;      // sum of _caps
+   uint64_t                _rand;     // xorshift state
+   int                     _min;
+   int                     _max;
+   size_t                  _w;        // weight of level #0
+   size_t                  _nBlock;   // #items sampled into _pick
+   int                     _pick;
+   vector<vector<int> >    _levels;
+   vector<size_t>          _caps;     // capacity of every level
+
+   uint64_t next() {
+      _rand ^= _rand << 13; _rand ^= _rand >> 7; _rand ^= _rand << 17;
+      return _rand;
+   }
+   // halve the items of level #h into level #h+1; an odd one is left
+   void compact(size_t h) {
+      vector<int>& l = _levels[h], &u = _levels[h + 1];
+      std::sort(l.begin(), l.end());
+      size_t m = l.size() & ~size_t(1);
+      for (size_t i = next() & 1; i < m; i += 2) u.push_back(l[i]);
+      l.erase(l.begin(), l.begin() + m);
+      _size -= m / 2;
+   }
+   // add a level on the top; fold level #0 into the sampler if it's too
+   // small, its odd item (if any) being the pick of w of the 2w items
+   void grow() {
+      _levels.push_back(vector<int>());
+      if (ceil(_k * pow(2.0 / 3, double(_levels.size() - 1))) < DB_KLL_M) {
+         compact(0);
+         if (_levels[0].size()) {
+            _pick = _levels[0][0];
+            _nBlock = _w;
+            --_size;
+         }
+         _levels.erase(_levels.begin());
+         _w *= 2;
+      }
+      size_t nl = _levels.size();
+      _caps.resize(nl);
+      _cap = 0;
+      for (size_t h = 0; h < nl; ++h) {
+         double c = ceil(_k * pow(2.0 / 3, double(nl - 1 - h)));
+         _cap += _caps[h] = c < DB_KLL_M? DB_KLL_M: size_t(c);
+      }
+   }
+   void compress() {
+      for (size_t h = 0; h < _levels.size(); ++h) {
+         if (_levels[h].size() < _caps[h]) continue;
+         if (h + 1 == _levels.size()) grow();
+         if (h + 1 == _levels.size()) --h;   // level #h was folded
+         compact(h);
+         return;
+      }
+   }
+};
+
+// The rank (0-based) of the p-quantile of n values by the nearest-rank
+// method: the smallest value with at least p * n values <= it. So the 0-
+// and the 1-quantiles are the min and the max.
+static size_t
+quantileRank(double p, size_t n)
+{
+   size_t r = size_t(ceil(p * double(n)));
+   return r? (r < n? r - 1: n - 1): 0;
+}
+
+void
+DBKllSketch::quantiles(const vector<double>& p, size_t n, vector<int>& q)
+   const
+{
+   vector<pair<int, size_t> > items;   // (value, weight)
+   items.reserve(_size + 1);
+   for (size_t h = 0; h < _levels.size(); ++h)
+      for (size_t i = 0, m = _levels[h].size(); i < m; ++i)
+         items.push_back(make_pair(_levels[h][i], _w << h));
+   if (_nBlock) items.push_back(make_pair(_pick, _nBlock));
+   sort(items.begin(), items.end());
+   q.resize(p.size());
+   for (size_t j = 0; j < p.size(); ++j) {
+      size_t r = quantileRank(p[j], n), w = 0, i = 0;
+      if (r == 0) { q[j] = _min; continue; }
+      if (r + 1 == n) { q[j] = _max; continue; }
+      while (i + 1 < items.size() && (w += items[i].second) <= r) ++i;
+      q[j] = items[i].first;
+   }
+}
+
+/*****************************************/
+/*   Member Functions for class DBTable  */
+/*****************************************/
+// Rows of the k largest non-null cells of column #c, in decreasing order
+// of the cells (and increasing rows on ties). The best k so far are kept
+// in a heap with the worst on the top; once it is full, only a better cell
+// can get in. The zones are visited in decreasing order of their max, so
+// the heap fills up with the best ones first, and the rest of the zones
+// are skipped as soon as their max is worse than the top.
+void
+DBTable::top(size_t c, size_t k, vector<uint32_t>& rows) const
+{
+   typedef pair<int, uint32_t> Cand;   // (cell, row)
+   auto better = [](const Cand& a, const Cand& b) {
+      return a.first > b.first || (a.first == b.first && a.second < b.second);
+   };
+   rows.clear();
+   if (!k) return;
+   const DBColumn& col = _cols[c];
+   vector<size_t> zones(col.nZones());
+   for (size_t z = 0; z < zones.size(); ++z) zones[z] = z;
+   std::stable_sort(zones.begin(), zones.end(), [&](size_t a, size_t b) {
+      return col.zone(a)._max > col.zone(b)._max; });
+   vector<Cand> h;
+   h.reserve(min(k, col.stats()._count));
+   for (size_t i = 0; i < zones.size(); ++i) {
+      size_t z = zones[i];
+      if (h.size() == k &&
+          !better(Cand(col.zone(z)._max, uint32_t(col.zoneBegin(z))), h[0]))
+         break;
+      col.forEachValid(z, [&](size_t r, int d) {
+         if (h.size() < k) {
+            h.push_back(Cand(d, uint32_t(r)));
+            push_heap(h.begin(), h.end(), better);
+         }
+         else if (better(Cand(d, uint32_t(r)), h[0])) {
+            pop_heap(h.begin(), h.end(), better);
+            h.back() = Cand(d, uint32_t(r));
+            push_heap(h.begin(), h.end(), better);
+         }
+      });
+   }
+   std::sort(h.begin(), h.end(), better);
+   rows.resize(h.size());
+   for (size_t i = 0; i < h.size(); ++i) rows[i] = h[i].second;
+}
+
+// Exact quantiles (see quantileRank()) of the non-null cells of column #c,
+// one for each of 'p'. The cells are copied out, and nth_element() finds
+// the ranks in increasing order, each one in the part above the previous
+// one. Return false if the column is all nulls.
+bool
+DBTable::quantiles(size_t c, const vector<double>& p, vector<int>& q) const
+{
+   const DBColumn& col = _cols[c];
+   vector<int> v;
+   v.reserve(col.stats()._count);
+   col.forEachValid([&](size_t, int d) { v.push_back(d); });
+   q.clear();
+   if (v.empty()) return false;
+   vector<pair<size_t, size_t> > r(p.size());   // (rank, index in p)
+   for (size_t i = 0; i < p.size(); ++i)
+      r[i] = make_pair(quantileRank(p[i], v.size()), i);
+   std::sort(r.begin(), r.end());
+   q.resize(p.size());
+   size_t lo = 0;
+   for (size_t i = 0; i < r.size(); ++i) {
+      nth_element(v.begin() + lo, v.begin() + r[i].first, v.end());
+      q[r[i].second] = v[r[i].first];
+      lo = r[i].first;
+   }
+   return true;
+}
+
+// Same as quantiles(), but in one pass through a KLL sketch of O(k) memory
+// instead of a copy of the column. 'rankErr' returns the rank error bound.
+bool
+DBTable::approxQuantiles(size_t c, const vector<double>& p, vector<int>& q,
+                         double& rankErr) const
+{
+   DBKllSketch s;
+   size_t n = 0;
+   _cols[c].forEachValid([&](size_t, int d) { s.add(d); ++n; });
+   rankErr = s.rankError();
+   q.clear();
+   if (!n) return false;
+   s.quantiles(p, n, q);
+   return true;
+}
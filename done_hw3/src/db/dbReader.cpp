@@ -0,0 +1,176 @@
+/****************************************************************************
+  FileName     [ dbReader.cpp ]
+  PackageName  [ db ]
+  Synopsis     [ Define the memory-mapped csv loader of DBTable ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2015-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "dbTable.h"
+#include "dbReader.h"
+#include "dbThread.h"
+
+using namespace std;
+
+/*******************************************/
+/* Member Functions for class DBMappedFile */
+/*******************************************/
+bool
+DBMappedFile::open(const string& fileName)
+{
+   close();
+   int fd = ::open(fileName.c_str(), O_RDONLY);
+   if (fd < 0) return false;
+   struct stat st;
+   if (fstat(fd, &st) != 0) { ::close(fd); return false; }
+   _size = size_t(st.st_size);
+   if (_size) {
+      void* p = mmap(0, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p == MAP_FAILED) { ::close(fd); _size = 0; return false; }
+      madvise(p, _size, MADV_SEQUENTIAL);
+      _data = (const char*)p;
+   }
+   ::close(fd);  // the mapping stays valid after the fd is closed
+   return true;
+}
+
+void
+DBMappedFile::close()
+{
+   if (_data) munmap((void*)_data, _size);
+   _data = 0; _size = 0;
+}
+
+/*****************************************/
+/*   Member Functions for class DBTable  */
+/*****************************************/
+// Read the csv file by mmap(). The lines are counted first so that every
+// column is allocated once (filled with nulls); then the cells are parsed
+// in place and only the non-null ones are written. Same as operator >>,
+// the first non-empty line decides #columns of an empty table, and an empty
+// line is a row of nulls only in a 1-column table (see dbEmptyLineEnd()).
+// With nThreads > 1, the file is cut into newline-aligned chunks that are
+// parsed into their own column segments by a pool of threads; the
+// segments are then pasted into the table in the file order.
+// At last, every column is encoded (see DBColumn::encode()).
+bool
+DBTable::readCsv(const string& fileName, size_t nThreads, size_t& nBytes)
+{
+   DBMappedFile f;
+   if (!f.open(fileName)) return false;
+   const char* b = f.data(), *e = b + f.size();
+   nBytes = f.size();
+
+   initCols(b, e);
+   if (_cols.empty()) return true;  // no data at all
+
+   size_t r0 = _nRows, nc = _cols.size();
+   size_t nChunks = nThreads * 4, minChunk = 1 << 20;
+   if (size_t(e - b) / minChunk + 1 < nChunks)
+      nChunks = size_t(e - b) / minChunk + 1;
+   if (nThreads <= 1 || nChunks <= 1) {
+      addCsv(b, e);
+      for (size_t c = 0; c < nc; ++c) _cols[c].encode();
+      return true;
+   }
+
+   vector<const char*> bounds(nChunks + 1, e);
+   bounds[0] = b;
+   for (size_t i = 1; i < nChunks; ++i) {
+      const char* p = b + size_t(e - b) * i / nChunks;
+      if (p < bounds[i - 1]) p = bounds[i - 1];
+      p = (const char*)memchr(p, '\n', e - p);
+      bounds[i] = p? p + 1: e;
+   }
+   vector<vector<DBColumn> > segs(nChunks);
+   dbParallelFor(nChunks, nThreads, [&](size_t i) {
+      const char* cb = bounds[i], *ce = bounds[i + 1];
+      size_t n = dbCountLines(cb, ce);
+      segs[i].assign(nc, DBColumn(n));
+      n = parseCsv(cb, ce, segs[i], 0);
+      for (size_t c = 0; c < nc; ++c) segs[i][c].resize(n);
+   });
+   vector<size_t> offsets(nChunks + 1, r0);
+   for (size_t i = 0; i < nChunks; ++i)
+      offsets[i + 1] = offsets[i] + (nc? segs[i][0].size(): 0);
+   _nRows = offsets[nChunks];
+   dbParallelFor(nc, nThreads, [&](size_t c) {
+      _cols[c].resize(_nRows);
+      for (size_t i = 0; i < nChunks; ++i) {
+         _cols[c].paste(offsets[i], segs[i][c]);
+         segs[i][c].reset();
+      }
+      _cols[c].encode();
+   });
+   return true;
+}
+
+// Append the lines of [b, e) in one pass: the lines are counted, every
+// column grows once (filled with nulls), and then the cells are parsed in
+// place. The columns are left plain, so that more appends are cheap.
+size_t
+DBTable::addCsv(const char* b, const char* e)
+{
+   initCols(b, e);
+   size_t r0 = _nRows, nc = _cols.size();
+   if (!nc) return 0;
+   size_t n = dbCountLines(b, e);
+   for (size_t c = 0; c < nc; ++c) _cols[c].resize(r0 + n);
+   n = parseCsv(b, e, _cols, r0);
+   for (size_t c = 0; c < nc; ++c) {
+      _cols[c].resize(r0 + n);
+      _cols[c].touch(r0, r0 + n);
+   }
+   _nRows = r0 + n;
+   return n;
+}
+
+// For an empty table, #columns is the #cells of the first non-empty line
+void
+DBTable::initCols(const char* b, const char* e)
+{
+   if (!_cols.empty()) return;
+   for (const char* next = b; b < e; b = next) {
+      const char* le = dbLineEnd(b, e, next);
+      if (le == b) continue;
+      _cols.assign(dbCountCells(b, le), DBColumn(_nRows));
+      break;
+   }
+}
+
+// Parse the lines in [b, e) into rows #r, #r+1... of 'cols', which must be
+// large enough and hold nulls there. Return #rows parsed.
+size_t
+DBTable::parseCsv(const char* b, const char* e, vector<DBColumn>& cols,
+                  size_t r)
+{
+   size_t r0 = r, nc = cols.size();
+   const char* p = b;
+   while (p < e) {
+      const char* q = dbEmptyLineEnd(p, e);
+      if (q != p) {  // the row stays null
+         p = q;
+         if (nc == 1) ++r;
+         continue;
+      }
+      const uint64_t bit = uint64_t(1) << (r & 63);
+      const size_t w = r >> 6;
+      for (size_t c = 0; ; ++c) {
+         int d;
+         p = dbParseCell(p, e, d);
+         if (d != INT_MAX && c < nc) {
+            cols[c]._data[r] = d;
+            cols[c]._valid[w] |= bit;
+         }
+         if (p == e || *p != ',') break;
+         ++p;
+      }
+      if (p < e && *p == '\r') ++p;
+      if (p < e && *p == '\n') ++p;
+      ++r;
+   }
+   return r - r0;
+}
@@ -0,0 +1,180 @@
+/****************************************************************************
+  FileName     [ dbReader.h ]
+  PackageName  [ db ]
+  Synopsis     [ Define memory-mapped file and csv scanning helpers ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2015-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+#ifndef DB_READER_H
+#define DB_READER_H
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <climits>
+#include <stdint.h>
+#include <functional>
+#include "dbKernel.h"
+
+using namespace std;
+
+class DBHyperLogLog;
+
+// A read-only, private mapping of a whole file
+class DBMappedFile
+{
+public:
+   DBMappedFile() : _data(0), _size(0) {}
+   ~DBMappedFile() { close(); }
+
+   bool open(const string& fileName);
+   void close();
+   const char* data() const { return _data; }
+   size_t size() const { return _size; }
+
+private:
+   const char*   _data;
+   size_t        _size;
+
+   DBMappedFile(const DBMappedFile&);              // no copy
+   DBMappedFile& operator = (const DBMappedFile&); // no copy
+};
+
+// Number of lines in [b, e); a last line without '\n' is counted too.
+// memchr() is vectorized in libc, so this runs at memory bandwidth.
+inline size_t dbCountLines(const char* b, const char* e)
+{
+   size_t n = 0;
+   while (b < e) {
+      const char* p = (const char*)memchr(b, '\n', e - b);
+      ++n;
+      if (!p) break;
+      b = p + 1;
+   }
+   return n;
+}
+
+inline bool dbIsCellEnd(char ch)
+{
+   return ch == ',' || ch == '\n' || ch == '\r';
+}
+
+// Length of the run of decimal digits at the beginning of the 8 bytes in
+// 'x' (the first byte is the lowest one), tested for all bytes at once.
+inline unsigned dbDigitRun(uint64_t x)
+{
+   const uint64_t ones = 0x0101010101010101ULL, highs = ones * 0x80;
+   uint64_t lo = x & (ones * 0x7f);  // then no carry across the bytes
+   uint64_t digit = ((ones * (127 + '9' + 1) - lo) & ~x
+                    & (lo + ones * (127 - ('0' - 1)))) & highs;
+   uint64_t other = ~digit & highs;
+   return other? unsigned(__builtin_ctzll(other)) >> 3: 8;
+}
+
+// Value of the first n (1 <= n <= 8) digits in 'x', by SWAR multiplication
+inline unsigned dbParseDigits(uint64_t x, unsigned n)
+{
+   x -= 0x3030303030303030ULL;
+   x <<= (8 - n) << 3;  // right-align; the leading bytes become 0
+   x = x * 10 + (x >> 8);
+   x = (((x & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+        (((x >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+   return unsigned(x);
+}
+
+// Parse the csv cell starting at 'p' the same way as atoi(), i.e. leading
+// blanks and trailing garbage are ignored. An empty cell gives INT_MAX
+// (null). Return the past-the-end of the cell (i.e. ',', '\r', '\n' or
+// 'e'). The common case, [-]d{1,7} followed by the cell end, is converted
+// without a per-character loop when 9 bytes are readable.
+inline const char* dbParseCell(const char* p, const char* e, int& d)
+{
+   if (p + 9 <= e) {
+      bool neg = (*p == '-');
+      const char* q = p + neg;
+      uint64_t x;
+      memcpy(&x, q, 8);
+      unsigned n = dbDigitRun(x);
+      if (n && n < 8 && dbIsCellEnd(q[n])) {
+         unsigned v = dbParseDigits(x, n);
+         d = neg? -int(v): int(v);
+         return q + n;
+      }
+   }
+   if (p == e || dbIsCellEnd(*p)) { d = INT_MAX; return p; }
+   while (p < e && (*p == ' ' || *p == '\t')) ++p;
+   bool neg = false;
+   if (p < e && (*p == '-' || *p == '+')) neg = (*p++ == '-');
+   unsigned v = 0;
+   while (p < e && unsigned(*p - '0') < 10)
+      v = v * 10 + unsigned(*p++ - '0');
+   d = neg? -int(v): int(v);
+   while (p < e && !dbIsCellEnd(*p)) ++p;
+   return p;
+}
+
+// Return the end of the line starting at 'b' (excluding "\r\n" or "\n"),
+// and set 'next' to the beginning of the next line.
+inline const char* dbLineEnd(const char* b, const char* e, const char*& next)
+{
+   const char* p = (const char*)memchr(b, '\n', e - b);
+   if (!p) p = next = e;
+   else next = p + 1;
+   if (p > b && p[-1] == '\r') --p;
+   return p;
+}
+
+// If the line at 'p' is empty ("\n" or "\r\n"), return the start of the
+// next line; otherwise return 'p'. As a missing cell is a null, an empty
+// line is a row of nulls in a 1-column table; with more columns, it is
+// skipped.
+inline const char* dbEmptyLineEnd(const char* p, const char* e)
+{
+   const char* q = (p < e && *p == '\r')? p + 1: p;
+   return (q < e && *q == '\n')? q + 1: p;
+}
+
+// Number of cells of the line [b, le)
+inline size_t dbCountCells(const char* b, const char* le)
+{
+   size_t n = 1;
+   for (const char* p = b; (p = (const char*)memchr(p, ',', le - p)); ++p)
+      ++n;
+   return n;
+}
+
+// Stream a csv file in one pass and bounded memory (see dbScan.cpp): the
+// function is called on consecutive blocks [b, e) of whole lines, and may
+// return false to stop. Return false if the file cannot be read.
+typedef function<bool(const char*, const char*)> DBCsvBlockFunc;
+bool dbStreamCsv(const string& fileName, const DBCsvBlockFunc& scan,
+                 size_t& nBytes);
+
+// Aggregate column #c of the csv file in one pass and bounded memory, i.e.
+// without loading it as a table (see dbScan.cpp). 'a' aggregates the
+// non-null cells and 'hll' (if not 0) sketches their distinct count.
+// As in DBTable::readCsv(), the first line decides 'nCols', and the scan
+// stops right there if c >= nCols. Return false if the file cannot be read.
+bool dbScanCsv(const string& fileName, size_t c, DBColAgg& a,
+               DBHyperLogLog* hll, size_t& nCols, size_t& nRows,
+               size_t& nBytes);
+
+// Sort the csv file 'inFile' on the columns 'keys' into the csv file
+// 'outFile' in about 'memBudget' bytes of memory, by an external merge
+// sort (see dbExtSort.cpp). Return false if a file cannot be read or
+// written, or if a key is not less than st._nCols.
+struct DBExtSortStat
+{
+   DBExtSortStat() : _nCols(0), _nRows(0), _nRuns(0), _nBytes(0) {}
+
+   size_t   _nCols;
+   size_t   _nRows;
+   size_t   _nRuns;    // #sorted runs (temporary files if more than 1)
+   size_t   _nBytes;   // of 'inFile'
+};
+
+bool dbSortCsv(const string& inFile, const string& outFile,
+               const vector<size_t>& keys, size_t memBudget,
+               DBExtSortStat& st);
+
+#endif // DB_READER_H
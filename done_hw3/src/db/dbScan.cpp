@@ -0,0 +1,165 @@
+/****************************************************************************
+  FileName     [ dbScan.cpp ]
+  PackageName  [ db ]
+  Synopsis     [ Define the streaming (out-of-core) aggregation of csv files ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2015-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <future>
+#include <vector>
+#include "dbReader.h"
+#include "dbHash.h"
+
+using namespace std;
+
+// Size of each of the two read buffers
+#define DB_SCAN_BUF  (size_t(1) << 22)
+
+//----------------------------------------------------------------------
+//    DBCsvScan: the aggregation state of dbScanCsv()
+//----------------------------------------------------------------------
+class DBCsvScan
+{
+public:
+   DBCsvScan(size_t c, DBColAgg& a, DBHyperLogLog* hll)
+      : _c(c), _agg(a), _hll(hll), _nCols(0), _nRows(0), _nLead(0) {}
+
+   // Aggregate the lines in [b, e), which end with '\n' (but maybe the
+   // last line of the file). Return false if #c is out of range.
+   bool scan(const char* b, const char* e);
+   size_t nCols() const { return _nCols; }
+   size_t nRows() const { return _nRows; }
+
+private:
+   size_t           _c;
+   DBColAgg&        _agg;
+   DBHyperLogLog*   _hll;
+   size_t           _nCols;
+   size_t           _nRows;
+   size_t           _nLead;   // empty lines before #columns is known
+};
+
+bool
+DBCsvScan::scan(const char* b, const char* e)
+{
+   const char* p = b;
+   while (p < e) {
+      const char* q = dbEmptyLineEnd(p, e);
+      if (q != p) {  // a row of nulls in a 1-column file
+         p = q;
+         if (!_nCols) ++_nLead;
+         else if (_nCols == 1) ++_nRows;
+         continue;
+      }
+      if (!_nCols) {
+         const char* next;
+         _nCols = dbCountCells(p, dbLineEnd(p, e, next));
+         if (_c >= _nCols) return false;
+         if (_nCols == 1) _nRows += _nLead;
+      }
+      size_t k = 0;
+      for (; k < _c && p < e && *p != '\n' && *p != '\r'; ++p)
+         if (*p == ',') ++k;
+      if (k == _c) {
+         int d;
+         p = dbParseCell(p, e, d);
+         if (d != INT_MAX) {
+            ++_agg._count;
+            _agg._sum += d;
+            if (d < _agg._min) _agg._min = d;
+            if (d > _agg._max) _agg._max = d;
+            if (_hll) _hll->add(d);
+         }
+      }
+      p = (const char*)memchr(p, '\n', e - p);
+      p = p? p + 1: e;
+      ++_nRows;
+   }
+   return true;
+}
+
+/*****************************************/
+/*          Static Functions             */
+/*****************************************/
+// read() until 'n' bytes or the end of file; -1 on error
+static ssize_t
+readFull(int fd, char* p, size_t n)
+{
+   size_t m = 0;
+   while (m < n) {
+      ssize_t k = ::read(fd, p + m, n - m);
+      if (k < 0) return -1;
+      if (!k) break;
+      m += size_t(k);
+   }
+   return ssize_t(m);
+}
+
+/*****************************************/
+/*          Global Functions             */
+/*****************************************/
+// The file is read by read() into two buffers in turn: while one buffer is
+// scanned, the next one is being filled by an asynchronous task. A line
+// cut at the end of a buffer is carried over to the next one.
+bool
+dbStreamCsv(const string& fileName, const DBCsvBlockFunc& scan,
+            size_t& nBytes)
+{
+   int fd = ::open(fileName.c_str(), O_RDONLY);
+   if (fd < 0) return false;
+#ifdef POSIX_FADV_SEQUENTIAL
+   posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+   struct stat st;
+   size_t bufSize = DB_SCAN_BUF;  // a small file takes just one buffer
+   if (fstat(fd, &st) == 0 && size_t(st.st_size) < bufSize)
+      bufSize = size_t(st.st_size) + 1;
+   vector<char> buf[2] = { vector<char>(bufSize), vector<char>(bufSize) };
+   string carry;   // the unfinished last line of the previous buffer
+   bool ok = true, more = true;
+   nBytes = 0;
+   future<ssize_t> next =
+      async(launch::async, readFull, fd, buf[0].data(), bufSize);
+   for (size_t cur = 0; more; cur ^= 1) {
+      ssize_t n = next.get();
+      if (n < 0) { ok = false; break; }
+      if (!n) break;
+      nBytes += size_t(n);
+      next = async(launch::async, readFull, fd, buf[cur ^ 1].data(),
+                   bufSize);
+      const char* b = buf[cur].data(), *e = b + n;
+      const char* p = (const char*)memchr(b, '\n', e - b);
+      if (!p) { carry.append(b, e); continue; }
+      if (carry.size()) {
+         carry.append(b, p + 1);
+         more = scan(carry.data(), carry.data() + carry.size());
+         carry.clear();
+         b = p + 1;
+      }
+      const char* last = e;
+      while (last > b && last[-1] != '\n') --last;
+      if (more) more = scan(b, last);
+      carry.assign(last, e);
+   }
+   if (next.valid()) next.wait();
+   if (ok && more && carry.size())
+      scan(carry.data(), carry.data() + carry.size());
+   ::close(fd);
+   return ok;
+}
+
+// The lines are parsed by the same cell tokenizer as DBTable::readCsv()
+bool
+dbScanCsv(const string& fileName, size_t c, DBColAgg& a, DBHyperLogLog* hll,
+          size_t& nCols, size_t& nRows, size_t& nBytes)
+{
+   DBCsvScan s(c, a, hll);
+   bool ok = dbStreamCsv(fileName, [&](const char* b, const char* e) {
+      return s.scan(b, e); }, nBytes);
+   nCols = s.nCols();
+   nRows = s.nRows();
+   return ok;
+}
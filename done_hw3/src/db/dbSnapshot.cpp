@@ -0,0 +1,238 @@
+/****************************************************************************
+  FileName     [ dbSnapshot.cpp ]
+  PackageName  [ db ]
+  Synopsis     [ Define the binary snapshot (save/load) of DBTable ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2015-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+#include <cstring>
+#include <cassert>
+#include <atomic>
+#include "dbTable.h"
+#include "dbReader.h"
+#include "dbCodec.h"
+#include "dbThread.h"
+
+using namespace std;
+
+// Snapshot file layout (native little-endian; every section starts at a
+// multiple of DB_SNAP_ALIGN, which allows a mapped column to be used in
+// place later; load() still copies it out):
+//    DBSnapHeader
+//    DBSnapCol[nCols]          -- the column directory
+//    for each column: validity bitmap (8 * ceil(nRows / 64) bytes), cells
+// The cells are either nRows raw int's (DB_SNAP_RAW), or frame of reference
+// + bit packing (DB_SNAP_FOR; see dbPack()). The aggregate of each column
+// is saved too; load() checks it against the cells.
+#define DB_SNAP_MAGIC    0x50414e5342444244ULL   // "DBDBSNAP"
+#define DB_SNAP_VERSION  1
+#define DB_SNAP_ALIGN    64
+
+enum DBSnapEncoding
+{
+   DB_SNAP_RAW = 0,
+   DB_SNAP_FOR = 1
+};
+
+struct DBSnapHeader
+{
+   uint64_t   _magic;
+   uint32_t   _version;
+   uint32_t   _nCols;
+   uint64_t   _nRows;
+   uint64_t   _reserved;
+};
+
+struct DBSnapCol
+{
+   uint32_t   _encoding;
+   uint32_t   _bits;        // DB_SNAP_FOR: bits per cell
+   int32_t    _base;        // DB_SNAP_FOR: frame of reference
+   int32_t    _min;
+   int32_t    _max;
+   uint32_t   _reserved;
+   uint64_t   _count;       // #non-null cells
+   int64_t    _sum;
+   uint64_t   _validOff;    // file offsets of the two sections
+   uint64_t   _dataOff;
+   uint64_t   _dataBytes;
+};
+
+/*****************************************/
+/*          Static Functions             */
+/*****************************************/
+static inline uint64_t
+snapAlign(uint64_t n)
+{
+   return (n + DB_SNAP_ALIGN - 1) & ~uint64_t(DB_SNAP_ALIGN - 1);
+}
+
+// Whether the section [off, off + len) is in a file of 'size' bytes and
+// 8-byte aligned (to be read as uint64_t/int in place); no sum can wrap
+static inline bool
+snapFits(uint64_t off, uint64_t len, size_t size)
+{
+   return off <= size && len <= size - off && !(off & (sizeof(uint64_t) - 1));
+}
+
+static bool
+writePadded(ofstream& ofs, const void* p, size_t n, uint64_t& pos)
+{
+   static const char zeros[DB_SNAP_ALIGN] = { 0 };
+   ofs.write((const char*)p, n);
+   uint64_t e = snapAlign(pos + n);
+   ofs.write(zeros, e - pos - n);
+   pos = e;
+   return bool(ofs);
+}
+
+/*****************************************/
+/*   Member Functions for class DBTable  */
+/*****************************************/
+// Save the table to 'fileName'. With 'compress', a column is saved by
+// frame of reference + bit packing if it needs fewer than 32 bits per cell.
+// 'nBytes' returns the file size. The deleted rows must be compacted first.
+bool
+DBTable::save(const string& fileName, bool compress, size_t& nBytes) const
+{
+   assert(!_dead.size());
+   ofstream ofs(fileName.c_str(), ios::binary | ios::trunc);
+   if (!ofs) return false;
+
+   size_t nc = _cols.size(), nw = (_nRows + 63) >> 6;
+   DBSnapHeader h;
+   memset(&h, 0, sizeof(h));
+   h._magic = DB_SNAP_MAGIC;
+   h._version = DB_SNAP_VERSION;
+   h._nCols = uint32_t(nc);
+   h._nRows = _nRows;
+
+   vector<DBSnapCol> dir(nc);
+   uint64_t pos = snapAlign(sizeof(h)) + snapAlign(nc * sizeof(DBSnapCol));
+   for (size_t c = 0; c < nc; ++c) {
+      const DBColAgg& a = _cols[c].stats();
+      DBSnapCol& d = dir[c];
+      memset(&d, 0, sizeof(d));
+      d._min = a._min; d._max = a._max;
+      d._count = a._count; d._sum = a._sum;
+      d._encoding = DB_SNAP_RAW;
+      d._dataBytes = _nRows * sizeof(int);
+      if (compress && a._count) {
+         unsigned bits = dbBitWidth(uint64_t(int64_t(a._max) - a._min));
+         if (bits < 32) {
+            d._encoding = DB_SNAP_FOR;
+            d._bits = bits;
+            d._base = a._min;
+            d._dataBytes = dbPackedBytes(_nRows, bits);
+         }
+      }
+      d._validOff = pos;
+      pos += snapAlign(nw * sizeof(uint64_t));
+      d._dataOff = pos;
+      pos += snapAlign(d._dataBytes);
+   }
+
+   pos = 0;
+   if (!writePadded(ofs, &h, sizeof(h), pos) ||
+       !writePadded(ofs, dir.data(), nc * sizeof(DBSnapCol), pos))
+      return false;
+   vector<uint64_t> packed;
+   vector<int> plain;
+   for (size_t c = 0; c < nc; ++c) {
+      const DBColumn& col = _cols[c];
+      if (!writePadded(ofs, col.validity(), nw * sizeof(uint64_t), pos))
+         return false;
+      const int* d = col.data();
+      if (!col.isPlain()) {
+         plain.resize(_nRows);
+         col.decode(0, _nRows, plain.data());
+         d = plain.data();
+      }
+      if (dir[c]._encoding == DB_SNAP_FOR) {
+         packed.assign(dir[c]._dataBytes >> 3, 0);
+         dbPack(d, col.validity(), _nRows, dir[c]._base, dir[c]._bits,
+                packed.data());
+         if (!writePadded(ofs, packed.data(), dir[c]._dataBytes, pos))
+            return false;
+      }
+      else if (!writePadded(ofs, d, dir[c]._dataBytes, pos))
+         return false;
+   }
+   nBytes = pos;
+   return true;
+}
+
+// Replace the table by the snapshot in 'fileName', which is mmap()'ed;
+// the raw columns and bitmaps are copied out with one memcpy() each, and
+// the packed ones are decoded by 'nThreads' threads. Then the columns are
+// encoded in memory as by readCsv(). Return false (and leave the table
+// unchanged) if the file is not a valid snapshot, e.g. if the saved
+// aggregate of a column does not match its cells.
+bool
+DBTable::load(const string& fileName, size_t nThreads, size_t& nBytes)
+{
+   DBMappedFile f;
+   if (!f.open(fileName)) return false;
+   const uint8_t* b = (const uint8_t*)f.data();
+   size_t size = f.size();
+   nBytes = size;
+
+   DBSnapHeader h;
+   if (size < sizeof(h)) return false;
+   memcpy(&h, b, sizeof(h));
+   if (h._magic != DB_SNAP_MAGIC || h._version > DB_SNAP_VERSION)
+      return false;
+   // a corrupt #rows/#columns is rejected before any vector is sized; the
+   // rows are addressed by uint32_t (e.g. in select())
+   uint64_t dirOff = snapAlign(sizeof(h));
+   if (h._nRows > UINT32_MAX || dirOff > size ||
+       h._nCols > (size - dirOff) / sizeof(DBSnapCol))
+      return false;
+   size_t nc = h._nCols, nr = h._nRows, nw = (nr + 63) >> 6;
+   vector<DBSnapCol> dir(nc);
+   memcpy(dir.data(), b + dirOff, nc * sizeof(DBSnapCol));
+   for (size_t c = 0; c < nc; ++c) {
+      const DBSnapCol& d = dir[c];
+      if (d._encoding == DB_SNAP_RAW) {
+         if (d._dataBytes != nr * sizeof(int)) return false;
+      }
+      else if (d._encoding != DB_SNAP_FOR || d._bits >= 32 ||
+               d._dataBytes != dbPackedBytes(nr, d._bits))
+         return false;
+      if (!snapFits(d._validOff, nw * sizeof(uint64_t), size) ||
+          !snapFits(d._dataOff, d._dataBytes, size))
+         return false;
+   }
+
+   vector<DBColumn> cols(nc);
+   atomic<bool> bad(false);
+   dbParallelFor(nc, nThreads, [&](size_t c) {
+      const DBSnapCol& d = dir[c];
+      DBColumn& col = cols[c];
+      const uint64_t* valid = (const uint64_t*)(b + d._validOff);
+      col._valid.assign(valid, valid + nw);
+      if (d._encoding == DB_SNAP_RAW) {
+         const int* p = (const int*)(b + d._dataOff);
+         col._data.assign(p, p + nr);
+      }
+      else {
+         col._data.resize(nr);
+         dbUnpack(b + d._dataOff, valid, 0, nr, d._base, d._bits,
+                  col._data.data());
+      }
+      col.resetZones();
+      DBColAgg& a = col._stats._agg;
+      a = DBColAgg();
+      dbAggregate(col._data.data(), col._valid.data(), nr, a);
+      if (a._count != d._count || a._sum != d._sum ||
+          (a._count && (a._min != d._min || a._max != d._max)))
+         bad = true;
+      col._stats._aggVer = col._version;
+      col.encode();
+   });
+   if (bad) return false;
+   _cols.swap(cols);
+   _nRows = nr;
+   _dead.reset();
+   return true;
+}
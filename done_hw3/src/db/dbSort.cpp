@@ -0,0 +1,158 @@
+/****************************************************************************
+  FileName     [ dbSort.cpp ]
+  PackageName  [ db ]
+  Synopsis     [ Define the sorting functions of DBTable ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2015-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+#include <algorithm>
+#include <cassert>
+#include "dbTable.h"
+#include "dbThread.h"
+
+using namespace std;
+
+// Below this many rows, a plain comparison sort beats the radix passes
+#define DB_RADIX_MIN_ROWS  4096
+#define DB_RADIX_BITS      11
+#define DB_RADIX_BUCKETS   (1 << DB_RADIX_BITS)
+
+/*****************************************/
+/*          Static Functions             */
+/*****************************************/
+// Map an int to an unsigned key of the same order; null (INT_MAX) maps to
+// the largest key, so nulls go last.
+static inline uint32_t
+radixKey(int d)
+{
+   return uint32_t(d) ^ 0x80000000u;
+}
+
+// One stable counting pass on digit 'shift' of (keys, idx) into (tk, ti).
+// Each of the nb blocks counts and scatters its own range, so the output
+// keeps the input order within a bucket.
+static void
+radixPass(const vector<uint32_t>& keys, const vector<uint32_t>& idx,
+          vector<uint32_t>& tk, vector<uint32_t>& ti, unsigned shift,
+          size_t nb, size_t nThreads, vector<size_t>& hist)
+{
+   size_t n = keys.size();
+   const uint32_t mask = DB_RADIX_BUCKETS - 1;
+   dbParallelFor(nb, nThreads, [&](size_t b) {
+      size_t* h = &hist[b * DB_RADIX_BUCKETS];
+      fill(h, h + DB_RADIX_BUCKETS, 0);
+      for (size_t i = n * b / nb, e = n * (b + 1) / nb; i < e; ++i)
+         ++h[(keys[i] >> shift) & mask];
+   });
+   // exclusive prefix sum in (bucket, block) order
+   size_t sum = 0;
+   for (size_t d = 0; d < DB_RADIX_BUCKETS; ++d)
+      for (size_t b = 0; b < nb; ++b) {
+         size_t c = hist[b * DB_RADIX_BUCKETS + d];
+         hist[b * DB_RADIX_BUCKETS + d] = sum;
+         sum += c;
+      }
+   dbParallelFor(nb, nThreads, [&](size_t b) {
+      size_t* h = &hist[b * DB_RADIX_BUCKETS];
+      for (size_t i = n * b / nb, e = n * (b + 1) / nb; i < e; ++i) {
+         size_t p = h[(keys[i] >> shift) & mask]++;
+         tk[p] = keys[i];
+         ti[p] = idx[i];
+      }
+   });
+}
+
+/*****************************************/
+/*   Member Functions for class DBTable  */
+/*****************************************/
+// Stable sort on the columns in 's'. The rows are not moved while sorting:
+// a permutation of row indices is sorted, and then every column is
+// permuted once. Nulls go after all the data of a column. The deleted
+// rows are compacted first.
+void
+DBTable::sort(const struct DBSort& s)
+{
+   compact();
+   if (s._sortOrder.empty() || _nRows < 2) return;
+   assert(_nRows < (size_t(1) << 32));  // row indices are kept in 32 bits
+   size_t nThreads = dbDefaultThreads();
+   // encoded columns are sorted as plain and then encoded again
+   vector<bool> encoded(_cols.size());
+   dbParallelFor(_cols.size(), nThreads, [&](size_t c) {
+      encoded[c] = !_cols[c].isPlain();
+      _cols[c].decode();
+   });
+   vector<uint32_t> order(_nRows);
+   for (size_t i = 0; i < _nRows; ++i) order[i] = uint32_t(i);
+   if (_nRows >= DB_RADIX_MIN_ROWS) radixSort(s, order, nThreads);
+   else mergeSort(s, order, nThreads);
+   dbParallelFor(_cols.size(), nThreads, [&](size_t c) {
+      _cols[c].permute(order);
+      if (encoded[c]) _cols[c].encode();
+   });
+   // TODO: sort the data according to the order of columns in 's'
+}
+
+// LSD radix sort: the keys are processed from the last one to the first;
+// as every pass is stable, the earlier keys take precedence. A key column
+// is gathered once into the current order and then sorted with its row
+// indices in 3 passes of 11 bits. A pass is skipped if all the rows have
+// the same digit (e.g. the high bits of small numbers).
+void
+DBTable::radixSort(const DBSort& s, vector<uint32_t>& order,
+                   size_t nThreads) const
+{
+   size_t n = _nRows;
+   size_t nb = nThreads > 1? nThreads * 4: 1;
+   vector<uint32_t> keys(n), tk(n), ti(n);
+   vector<size_t> hist(nb * DB_RADIX_BUCKETS);
+   for (size_t k = s._sortOrder.size(); k-- > 0; ) {
+      const int* d = _cols[s._sortOrder[k]].data();
+      dbParallelFor(nb, nThreads, [&](size_t b) {
+         for (size_t i = n * b / nb, e = n * (b + 1) / nb; i < e; ++i)
+            keys[i] = radixKey(d[order[i]]);
+      });
+      uint32_t all1 = ~0u, all0 = 0;  // bits common to all the keys
+      for (size_t i = 0; i < n; ++i) { all1 &= keys[i]; all0 |= keys[i]; }
+      for (unsigned shift = 0; shift < 32; shift += DB_RADIX_BITS) {
+         uint32_t m = uint32_t(DB_RADIX_BUCKETS - 1) << shift;
+         if ((all1 & m) == (all0 & m)) continue;
+         radixPass(keys, order, tk, ti, shift, nb, nThreads, hist);
+         keys.swap(tk);
+         order.swap(ti);
+      }
+   }
+}
+
+// Parallel stable merge sort with DBSort as the comparator: the runs are
+// sorted independently and then merged pairwise, level by level.
+void
+DBTable::mergeSort(const DBSort& s, vector<uint32_t>& order,
+                   size_t nThreads) const
+{
+   size_t n = order.size();
+   size_t nRuns = nThreads;
+   if (nRuns > n / 1024) nRuns = n / 1024;
+   if (nRuns < 1) nRuns = 1;
+   auto rowLess = [&](uint32_t a, uint32_t b) {
+      return s((*this)[a], (*this)[b]); };
+   vector<size_t> bounds(nRuns + 1);
+   for (size_t i = 0; i <= nRuns; ++i) bounds[i] = n * i / nRuns;
+   dbParallelFor(nRuns, nThreads, [&](size_t i) {
+      stable_sort(order.begin() + bounds[i], order.begin() + bounds[i + 1],
+                  rowLess);
+   });
+   vector<uint32_t> tmp(n);
+   for (size_t w = 1; w < nRuns; w *= 2) {
+      size_t nMerges = (nRuns + 2 * w - 1) / (2 * w);
+      dbParallelFor(nMerges, nThreads, [&](size_t m) {
+         size_t lo = bounds[2 * w * m];
+         size_t mid = bounds[min(2 * w * m + w, nRuns)];
+         size_t hi = bounds[min(2 * w * (m + 1), nRuns)];
+         merge(order.begin() + lo, order.begin() + mid,
+               order.begin() + mid, order.begin() + hi, tmp.begin() + lo,
+               rowLess);
+      });
+      order.swap(tmp);
+   }
+}
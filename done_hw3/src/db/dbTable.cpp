@@ -12,14 +12,25 @@
 #include <sstream>
 #include <iostream>
 #include <cctype>
+#include <cstring>
+#include <cstdlib>
 #include <cassert>
 #include <set>
 #include <algorithm>
 #include <climits>
 #include <vector>
 #include "dbTable.h"
+#include "dbKernel.h"
+#include "dbHash.h"
+#include "dbCodec.h"
+#include "dbThread.h"
+#include "dbFormat.h"
 #include "util.h"
 
+// DBTable::delRow() compacts the table once 1/DB_COMPACT_RATIO of the rows
+// are deleted
+#define DB_COMPACT_RATIO  4
+
 using namespace std;
 
 /*****************************************/
@@ -41,17 +52,34 @@ ostream& operator << (ostream& os, const DBRow& r)
    return os;
 }
 
+ostream& operator << (ostream& os, const DBRowView& r)
+{
+   for (size_t i=0, n=r.size() ; i<n ; i++) {
+      DBTable::printData(os, r[i]);
+      if (i!=n-1)
+         os << ' ';
+   }
+   return os;
+}
+
+// The rows are taken in blocks: each column is decoded once per block, and
+// then the block is formatted row by row into the buffer of a DBFormatter.
 ostream& operator << (ostream& os, const DBTable& t)
 {
-   for (size_t i=0 ; i<t.nRows() ; i++) {
-      for (size_t j=0 ; j<t.nCols() ; j++) {
-         os << setw(6);
-         if (t[i][j]==INT_MAX) 
-            os << '.';
-         else
-            os << t[i][j];
+   size_t nc = t.nCols();
+   vector<int> buf(nc * DB_DECODE_ROWS);
+   vector<const int*> d(nc);
+   DBFormatter f(os);
+   for (size_t b = 0; b < t._nRows; b += DB_DECODE_ROWS) {
+      size_t e = min(b + DB_DECODE_ROWS, t._nRows);
+      for (size_t j = 0; j < nc; ++j)
+         d[j] = t._cols[j].cells(b, e, buf.data() + j * DB_DECODE_ROWS);
+      for (size_t i = b; i < e; ++i) {
+         if (t._dead.isDead(i)) continue;
+         for (size_t j = 0; j < nc; ++j)
+            f.putCell(d[j][i - b], 6);
+         f.put('\n');
       }
-      os << endl;
    }
    // TODO: to print out a table
    // - Data are seperated by setw(6) and aligned right.
@@ -61,24 +89,22 @@ ostream& operator << (ostream& os, const DBTable& t)
 
 ifstream& operator >> (ifstream& ifs, DBTable& t)
 {
+   // One DBRow is reused for all the lines so that no per-row memory is
+   // allocated; the cells are parsed in place instead of via substr/erase.
    string line;
+   DBRow r;
    while (getline(ifs,line,'\n')) {
-      DBRow r;
-      if ( !(int(line.back())==44||isdigit(line.back()))) 
+      if (!line.empty() && !(line.back()==','||isdigit(line.back()))) 
          line.pop_back();
-      size_t pos = line.find_first_of(",");
-      while (pos!=string::npos) {
-         if ((line.substr(0,pos).size())==0) 
-            r.addData(INT_MAX);
-         else
-            r.addData(atoi(line.substr(0,pos).c_str()));
-         line.erase(0,pos+1);
-         pos = line.find_first_of(",");
+      if (line.empty() && t.nCols() != 1) continue;  // see dbEmptyLineEnd()
+      r.clear();
+      const char* p = line.c_str();
+      while (true) {
+         r.addData((*p == ',' || *p == '\0')? INT_MAX: atoi(p));
+         p = strchr(p, ',');
+         if (!p) break;
+         ++p;
       }
-      if ((line.substr(0,pos).size())==0) 
-         r.addData(INT_MAX);
-      else
-         r.addData(atoi(line.substr(0,pos).c_str()));
       t.addRow(r);
    }
    // TODO: to read in data from csv file and store them in a table
@@ -97,20 +123,367 @@ DBRow::removeCell(size_t c)
    // TODO
 }
 
+/*****************************************/
+/*  Member Functions for class DBColumn  */
+/*****************************************/
+DBColumn::DBColumn(const vector<int>& d)
+   : _data(d), _valid((d.size() + 63) >> 6, 0), _version(0),
+     _enc(DB_ENC_PLAIN), _nEnc(0), _bits(0), _base(0), _prefixBits(0)
+{
+   for (size_t r = 0, n = d.size(); r < n; ++r)
+      if (d[r] != INT_MAX) _valid[r >> 6] |= uint64_t(1) << (r & 63);
+   resetZones();
+}
+
+size_t
+DBColumn::nValid() const
+{
+   size_t nv = 0;
+   for (size_t w = 0, n = _valid.size(); w < n; ++w)
+      nv += __builtin_popcountll(_valid[w]);
+   return nv;
+}
+
+// min/max of the non-null cells from the cached aggregate if it is up to
+// date, or else from the zone map; false if all nulls
+bool
+DBColumn::getMinMax(int& mn, int& mx) const
+{
+   if (_stats._aggVer == _version) {
+      mn = _stats._agg._min; mx = _stats._agg._max;
+      return _stats._agg._count;
+   }
+   bool found = false;
+   mn = INT_MAX; mx = INT_MIN;
+   for (size_t z = 0, n = _zones.size(); z < n; ++z) {
+      const DBZone& zn = zone(z);
+      if (zn._nNull == zoneEnd(z) - zoneBegin(z)) continue;
+      found = true;
+      if (zn._min < mn) mn = zn._min;
+      if (zn._max > mx) mx = zn._max;
+   }
+   return found;
+}
+
+void
+DBColumn::touch(size_t b, size_t e)
+{
+   for (size_t z = b >> DB_ZONE_BITS; z < _zones.size() && zoneBegin(z) < e;
+        ++z)
+      _zones[z]._dirty = true;
+   bump(false);
+}
+
+const DBColAgg&
+DBColumn::stats() const
+{
+   if (_stats._aggVer != _version) {
+      _stats._agg = DBColAgg();
+      aggregate(0, size(), _stats._agg);
+      _stats._aggVer = _version;
+   }
+   return _stats._agg;
+}
+
+void
+DBColumn::set(size_t r, int d)
+{
+   if (_enc != DB_ENC_PLAIN) decode();
+   int o = _data[r];
+   zoneRemove(r >> DB_ZONE_BITS, o);
+   zoneAdd(r >> DB_ZONE_BITS, d);
+   DBColAgg& a = _stats._agg;
+   bool keep = (_stats._aggVer == _version) &&
+               (o == INT_MAX || (o != a._min && o != a._max));
+   if (keep) {
+      if (o != INT_MAX) { --a._count; a._sum -= o; }
+      if (d != INT_MAX) {
+         ++a._count; a._sum += d;
+         if (d < a._min) a._min = d;
+         if (d > a._max) a._max = d;
+      }
+   }
+   bump(keep, o == d);
+   _data[r] = d;
+   if (d == INT_MAX) _valid[r >> 6] &= ~(uint64_t(1) << (r & 63));
+   else _valid[r >> 6] |= uint64_t(1) << (r & 63);
+}
+
+// Growing is amortized: the capacity is at least doubled when exceeded,
+// so that a series of small appends costs O(1) per cell. The new cells are
+// nulls, filled in bulk (INT_MAX into _data, zero words into _valid).
+void
+DBColumn::resize(size_t n)
+{
+   if (_enc != DB_ENC_PLAIN) decode();
+   size_t m = _data.size();
+   if (n > _data.capacity())
+      reserve(max(n, _data.capacity() * 2));
+   _data.resize(n, INT_MAX);
+   _valid.resize((n + 63) >> 6, 0);
+   if (n & 63)  // clear the bits of the truncated cells
+      _valid.back() &= (uint64_t(1) << (n & 63)) - 1;
+   size_t nz = (n + DB_ZONE_ROWS - 1) >> DB_ZONE_BITS;
+   if (n < m) {
+      _zones.resize(nz);
+      if (nz) _zones.back()._dirty = true;
+      bump(false);
+      return;
+   }
+   bump(true, true);  // only nulls are added
+   while (_zones.size() < nz) {
+      _zones.push_back(DBZone());
+      _zones.back()._dirty = false;
+   }
+   for (size_t z = m >> DB_ZONE_BITS; z < nz; ++z)  // the new nulls
+      _zones[z]._nNull += zoneEnd(z) - max(zoneBegin(z), m);
+}
+
+// The column is first padded with nulls by resize(); then the non-null
+// cells are written over them, and the zones and the cached aggregate are
+// updated cell by cell as in push().
+void
+DBColumn::append(const int* d, size_t n, size_t stride)
+{
+   size_t m = size();
+   resize(m + n);
+   DBColAgg& a = _stats._agg;
+   const bool keep = _stats._aggVer == _version;
+   size_t nv = 0;
+   for (size_t i = 0; i < n; ++i, d += stride) {
+      int x = *d;
+      if (x == INT_MAX) continue;
+      size_t r = m + i;
+      _data[r] = x;
+      _valid[r >> 6] |= uint64_t(1) << (r & 63);
+      DBZone& zn = _zones[r >> DB_ZONE_BITS];
+      --zn._nNull;
+      if (x < zn._min) zn._min = x;
+      if (x > zn._max) zn._max = x;
+      if (keep) {
+         a._sum += x;
+         if (x < a._min) a._min = x;
+         if (x > a._max) a._max = x;
+      }
+      ++nv;
+   }
+   if (keep) a._count += nv;
+   bump(keep, !nv);
+}
+
+void
+DBColumn::erase(size_t r)
+{
+   if (_enc != DB_ENC_PLAIN) decode();
+   // Every later zone passes its first cell on to the previous zone
+   size_t z = r >> DB_ZONE_BITS, nz = _zones.size();
+   zoneRemove(z, _data[r]);
+   for (++z; z < nz; ++z) {
+      int d = _data[zoneBegin(z)];
+      zoneRemove(z, d);
+      zoneAdd(z - 1, d);
+   }
+   _data.erase(_data.begin() + r);
+   if (((_data.size() + DB_ZONE_ROWS - 1) >> DB_ZONE_BITS) < nz)
+      _zones.pop_back();
+   // shift the bits after r down by one, across the word boundaries
+   size_t w = r >> 6, nw = _valid.size();
+   uint64_t low = (uint64_t(1) << (r & 63)) - 1;
+   _valid[w] = (_valid[w] & low) | ((_valid[w] >> 1) & ~low);
+   for (size_t i = w + 1; i < nw; ++i) {
+      _valid[i - 1] |= (_valid[i] & 1) << 63;
+      _valid[i] >>= 1;
+   }
+   if (((_data.size() + 63) >> 6) < nw) _valid.pop_back();
+   bump(false);
+}
+
+// Copy 's' into rows [r, r + s.size()), which must be all nulls now.
+void
+DBColumn::paste(size_t r, const DBColumn& s)
+{
+   if (_enc != DB_ENC_PLAIN) decode();
+   size_t m = s.size();
+   if (!m) return;
+   if (s._enc != DB_ENC_PLAIN) {
+      DBColumn t(s);
+      t.decode();
+      paste(r, t);
+      return;
+   }
+   copy(s._data.begin(), s._data.end(), _data.begin() + r);
+   size_t w = r >> 6, off = r & 63;
+   for (size_t i = 0, nw = (m + 63) >> 6; i < nw; ++i) {
+      _valid[w + i] |= s._valid[i] << off;
+      if (off && w + i + 1 < _valid.size())
+         _valid[w + i + 1] |= s._valid[i] >> (64 - off);
+   }
+   touch(r, r + m);
+}
+
+// Rearrange the cells as cell #order[i] -> #i. 'order' may leave out some
+// rows (e.g. in DBTable::compact()), but only null ones.
+void
+DBColumn::permute(const vector<uint32_t>& order)
+{
+   if (_enc != DB_ENC_PLAIN) decode();
+   vector<int> tmp(order.size());
+   vector<uint64_t> valid((order.size() + 63) >> 6, 0);
+   for (size_t i = 0, n = order.size(); i < n; ++i) {
+      tmp[i] = _data[order[i]];
+      if (!isNull(order[i])) valid[i >> 6] |= uint64_t(1) << (i & 63);
+   }
+   tmp.swap(_data);
+   valid.swap(_valid);
+   resetZones();
+   bump(true, true);  // same cells in a different order
+}
+
+// Turn cell #r into a null in place, even if the column is encoded (the
+// decoders check the validity bitmap first); this is the tombstone of a
+// deleted row.
+void
+DBColumn::kill(size_t r)
+{
+   if (isNull(r)) return;
+   int o = (*this)[r];
+   if (_enc == DB_ENC_PLAIN) _data[r] = INT_MAX;
+   _valid[r >> 6] &= ~(uint64_t(1) << (r & 63));
+   zoneRemove(r >> DB_ZONE_BITS, o);
+   zoneAdd(r >> DB_ZONE_BITS, INT_MAX);
+   DBColAgg& a = _stats._agg;
+   bool keep = (_stats._aggVer == _version) && o != a._min && o != a._max;
+   if (keep) { --a._count; a._sum -= o; }
+   bump(keep);
+}
+
+void
+DBColumn::reset()
+{
+   vector<int> tmp; tmp.swap(_data);
+   vector<uint64_t> valid; valid.swap(_valid);
+   vector<DBZone> zones; zones.swap(_zones);
+   vector<uint64_t> packed; packed.swap(_packed);
+   vector<int> aux; aux.swap(_aux);
+   vector<uint64_t> prefix; prefix.swap(_prefix);
+   _enc = DB_ENC_PLAIN; _nEnc = 0;
+   _stats = DBColStats();
+   _index = DBColIndex();
+   ++_version;
+}
+
+void
+DBColumn::resetZones()
+{
+   _zones.assign((size() + DB_ZONE_ROWS - 1) >> DB_ZONE_BITS, DBZone());
+}
+
+void
+DBColumn::refreshZone(size_t z) const
+{
+   size_t b = zoneBegin(z), e = zoneEnd(z);
+   DBColAgg a;
+   aggregate(b, e, a);
+   DBZone& zn = _zones[z];
+   zn._min = a._min; zn._max = a._max;
+   zn._nNull = (e - b) - a._count;
+   zn._dirty = false;
+}
+
+// Aggregate cells [b, e) ('b' is a multiple of 64); an encoded column is
+// decoded block by block into a buffer that stays in L1.
+void
+DBColumn::aggregate(size_t b, size_t e, DBColAgg& a) const
+{
+   if (_enc == DB_ENC_PLAIN) {
+      dbAggregate(_data.data() + b, _valid.data() + (b >> 6), e - b, a);
+      return;
+   }
+   int buf[DB_DECODE_ROWS];
+   for (size_t i = b; i < e; i += DB_DECODE_ROWS) {
+      size_t j = min(i + DB_DECODE_ROWS, e);
+      decode(i, j, buf);
+      dbAggregate(buf, _valid.data() + (i >> 6), j - i, a);
+   }
+}
+
+/*****************************************/
+/* Member Functions for class DBDeadRows */
+/*****************************************/
+void
+DBDeadRows::kill(size_t r)
+{
+   size_t w = r >> 6;
+   if (w >= _bits.size()) _bits.resize(w + 1, 0);
+   uint64_t m = uint64_t(1) << (r & 63);
+   if (_bits[w] & m) return;
+   _bits[w] |= m;
+   ++_n;
+   size_t blk = (r >> DB_DEAD_BITS) + 1;
+   if (blk >= _tree.size()) {  // grow to a power of 2 and rebuild
+      size_t cap = 2;
+      while (cap <= blk) cap <<= 1;
+      _tree.assign(cap, 0);
+      for (size_t i = 0, n = _bits.size(); i < n; ++i)
+         _tree[(i >> (DB_DEAD_BITS - 6)) + 1] +=
+            __builtin_popcountll(_bits[i]);
+      for (size_t i = 1; i < cap; ++i) {
+         size_t j = i + (i & -i);
+         if (j < cap) _tree[j] += _tree[i];
+      }
+      return;
+   }
+   for (; blk < _tree.size(); blk += blk & -blk) ++_tree[blk];
+}
+
+// The physical row of the k-th (from 0) live row, if some rows are dead:
+// the Fenwick tree is descended to the block holding it, which is then
+// searched word by word.
+size_t
+DBDeadRows::search(size_t k) const
+{
+   size_t pos = 0;  // #blocks skipped
+   for (size_t step = _tree.size() >> 1; step; step >>= 1) {
+      if (pos + step >= _tree.size()) continue;
+      size_t live = (step << DB_DEAD_BITS) - _tree[pos + step];
+      if (live <= k) {
+         pos += step;
+         k -= live;
+      }
+   }
+   for (size_t w = pos << (DB_DEAD_BITS - 6); ; ++w) {
+      uint64_t alive = ~(w < _bits.size()? _bits[w]: 0);
+      size_t n = __builtin_popcountll(alive);
+      if (k < n) {
+         for (; k; --k) alive &= alive - 1;  // drop the k lowest live rows
+         return (w << 6) + __builtin_ctzll(alive);
+      }
+      k -= n;
+   }
+}
+
+void
+DBDeadRows::reset()
+{
+   vector<uint64_t> bits; bits.swap(_bits);
+   vector<uint32_t> tree; tree.swap(_tree);
+   _n = 0;
+}
+
 /*****************************************/
 /*   Member Functions for struct DBSort  */
 /*****************************************/
+// Lexicographic order on the columns in _sortOrder. Nulls (INT_MAX) are
+// greater than any data, so they go last.
 bool
-DBSort::operator() (const DBRow& r1, const DBRow& r2) const
+DBSort::operator() (const DBRowView& r1, const DBRowView& r2) const
 {
    for (size_t i=0 ; i<_sortOrder.size() ; i++) {
-      if (r1[_sortOrder[i]] > r2[_sortOrder[i]])  {
-         return 1;
-      }
+      int d1 = r1[_sortOrder[i]], d2 = r2[_sortOrder[i]];
+      if (d1 != d2)
+         return d1 < d2;
    }
-   // TODO: called as a functional object that compares the data in r1 and r2
-   //       based on the order defined in _sortOrder
-   return 0;
+   return false;
 }
 
 /*****************************************/
@@ -119,183 +492,245 @@ DBSort::operator() (const DBRow& r1, const DBRow& r2) const
 void
 DBTable::reset()
 {
-   while(nCols()>0) 
-      delRow(0);
+   vector<DBColumn> tmp;
+   tmp.swap(_cols);
+   _nRows = 0;
+   _dead.reset();
    // TODO
 }
 
 void
+DBTable::addRow(const DBRow& r)
+{
+   // The first row of an empty table decides the number of columns;
+   // afterwards, missing cells are nulls and extra cells are ignored.
+   if (_cols.empty())
+      _cols.assign(r.size(), DBColumn(_nRows));
+   for (size_t c = 0, n = _cols.size(); c < n; ++c)
+      _cols[c].push(c < r.size()? r[c]: INT_MAX);
+   ++_nRows;
+}
+
+// Column by column, so that each column grows once for the whole batch;
+// the columns beyond 'nCols' are padded with nulls.
+void
+DBTable::addRows(const int* cells, size_t n, size_t nCols)
+{
+   if (!n) return;
+   if (_cols.empty())
+      _cols.assign(nCols, DBColumn(_nRows));
+   for (size_t c = 0, nc = _cols.size(); c < nc; ++c) {
+      if (c < nCols) _cols[c].append(cells + c, n, nCols);
+      else _cols[c].resize(_nRows + n);
+   }
+   _nRows += n;
+}
+
+bool
 DBTable::addCol(const vector<int>& d)
 {
-   if (d.size()>nRows()) {}
-   else if (d.size() == nRows()) {
-      for (size_t i=0 ; i<nRows() ; i++) {
-         _table[i].addData(d[i]);
+   if (_cols.empty() && _nRows == 0)
+      _nRows = d.size();
+   if (d.size() > nRows()) return false;
+   compact();
+   _cols.push_back(DBColumn(d));
+   _cols.back().resize(_nRows);
+   // TODO: add a column to the right of the table. Data are in 'd'.
+   return true;
+}
+
+// The cells are gathered from the decoded source columns; the new columns
+// are plain.
+void
+DBTable::gather(const DBTable& t, const vector<uint32_t>& rows)
+{
+   size_t m = rows.size(), nc = t._cols.size();
+   vector<DBColumn> cols(nc);
+   vector<int> d(m), plain;
+   for (size_t c = 0; c < nc; ++c) {
+      const DBColumn& src = t._cols[c];
+      const int* s = src.data();
+      if (!src.isPlain()) {
+         plain.resize(t._nRows);
+         src.decode(0, t._nRows, plain.data());
+         s = plain.data();
       }
+      for (size_t i = 0; i < m; ++i) d[i] = s[rows[i]];
+      cols[c] = DBColumn(d);
    }
-   else {
-      for (size_t i=0 ; i<d.size() ; i++) 
-         _table[i].addData(d[i]);
-      for (size_t i=0 ; i<nRows()-d.size() ; i++)
-         _table[i+d.size()].addData(INT_MAX);
-   }   
-   // TODO: add a column to the right of the table. Data are in 'd'.
+   _cols.swap(cols);
+   _nRows = m;
+   _dead.reset();
 }
 
+// Delete the c-th live row by a tombstone: its cells become nulls in place
+// (so the scans and aggregates skip them), and its storage is only dropped
+// by compact(). This is done automatically once 1/DB_COMPACT_RATIO of the
+// rows are dead, which keeps a delete O(log n) amortized: the tombstone is
+// O(1), but finding the physical row of the c-th live row is O(log n).
 void
 DBTable::delRow(int c)
 {
-   _table.erase(_table.begin()+c);
+   size_t r = _dead.find(c);
+   _dead.kill(r);
+   for (size_t i = 0, n = _cols.size(); i < n; ++i)
+      _cols[i].kill(r);
+   if (_dead.size() * DB_COMPACT_RATIO >= _nRows) compact();
    // TODO: delete row #c. Note #0 is the first row.
 }
 
+// Remove the deleted rows from the storage; the encoded columns are
+// encoded again. The aggregates stay cached, as only nulls are removed.
+void
+DBTable::compact()
+{
+   if (!_dead.size()) return;
+   vector<uint32_t> live;
+   live.reserve(nRows());
+   for (size_t r = 0; r < _nRows; ++r)
+      if (!_dead.isDead(r)) live.push_back(uint32_t(r));
+   dbParallelFor(_cols.size(), dbDefaultThreads(), [&](size_t c) {
+      bool encoded = !_cols[c].isPlain();
+      _cols[c].permute(live);
+      if (encoded) _cols[c].encode();
+   });
+   _nRows = live.size();
+   _dead.reset();
+}
+
 void
 DBTable::delCol(int c)
 {
    // delete col #c. Note #0 is the first row.
-   for (size_t i = 0, n = _table.size(); i < n; ++i)
-      _table[i].removeCell(c);
+   _cols.erase(_cols.begin() + c);
+   if (_cols.empty()) {   // no rows without columns
+      _nRows = 0;
+      _dead.reset();
+   }
 }
 
 // For the following getXXX() functions...  (except for getCount())
 // - Ignore null cells
 // - If all the cells in column #c are null, return NAN
 // - Return "float" because NAN is a float.
+// getMax()/getMin() are answered from the zone maps; only the zones
+// changed since the last call are rescanned.
 float
 DBTable::getMax(size_t c) const
 {
-   int goodnum=0,max=INT_MIN;
-   for (size_t i=0 ; i<nRows() ; i++) {
-      if (_table[i][c] != INT_MAX) {
-         goodnum++;
-         if (_table[i][c] > max)
-            max = _table[i][c];
-      } 
-   }
-   if (goodnum)
-      return float(max);
-   else 
-      return NAN;
-   // TODO: get the max data in column #c
+   int mn, mx;
+   return _cols[c].getMinMax(mn, mx)? float(mx): NAN;
 }
 
 float
 DBTable::getMin(size_t c) const
 {
-   int goodnum=0,min=INT_MAX-1;
-   for (size_t i=0 ; i<nRows() ; i++) {
-      if (_table[i][c] != INT_MAX) {
-         goodnum++;
-         if (_table[i][c] < min)
-            min = _table[i][c];
-      } 
-   }
-   if (goodnum)
-      return float(min);
-   else 
-      return NAN;
-   // TODO: get the min data in column #c
-}
-
-float 
-DBTable::getSum(size_t c) const
-{
-   int goodnum=0,sum=0;
-   for (size_t i=0 ; i<nRows() ; i++) {
-      if (_table[i][c] != INT_MAX) {
-         goodnum++;
-         sum+=_table[i][c];
-      } 
-   }
-   if (goodnum)
-      return float(sum);
-   else 
-      return NAN;
-   // TODO: compute the sum of data in column #c
+   int mn, mx;
+   return _cols[c].getMinMax(mn, mx)? float(mn): NAN;
+}
+
+// The sum is accumulated and returned in 64 bits, which holds any sum of
+// up to 2^32 32-bit integers exactly; 'allNull' tells the NAN case apart.
+long long
+DBTable::getSum(size_t c, bool& allNull) const
+{
+   const DBColAgg& a = _cols[c].stats();
+   allNull = !a._count;
+   return a._sum;
 }
 
+// Distinct count of the non-null cells in column #c, by inserting them into
+// an open-addressing hash set (expected O(n) instead of O(n^2)). The
+// result is cached until the column changes.
 int
 DBTable::getCount(size_t c) const
 {
-   vector<int> v;
-   int goodnum=0;
-   bool neew=1;
-   for (size_t i=0 ; i<nRows() ; i++) {
-      if (_table[i][c]!=INT_MAX) {
-         goodnum++;
-         for (size_t j=0 ; j<v.size() ; j++) {
-            if (_table[i][c] == v[j])
-               neew=0;
-         }
-         if (neew)
-            v.push_back(_table[i][c]);
-         neew=1;
-      }
+   const DBColumn& col = _cols[c];
+   DBColStats& st = col._stats;
+   if (st._distinctVer != col.version()) {
+      DBIntHashSet hs;
+      col.forEachValid([&](size_t, int d) { hs.insert(d); });
+      st._nDistinct = hs.size();
+      st._distinctVer = col.version();
    }
-   if (goodnum)
-      return v.size();
-   else 
-      return INT_MAX;                  //return if nothing?
+   return int(st._nDistinct);
+}
 
-   // TODO: compute the number of distinct data in column #c
-   // - Ignore null cells
-   
+// Same as getCount(), but with a HyperLogLog sketch of fixed memory.
+// 'relErr' returns the standard error of the estimate.
+int
+DBTable::getApproxCount(size_t c, double& relErr) const
+{
+   const DBColumn& col = _cols[c];
+   DBColStats& st = col._stats;
+   if (st._approxVer != col.version()) {
+      DBHyperLogLog hll;
+      col.forEachValid([&](size_t, int d) { hll.add(d); });
+      st._nApprox = size_t(hll.estimate() + 0.5);
+      st._relErr = hll.relError();
+      st._approxVer = col.version();
+   }
+   relErr = st._relErr;
+   return int(st._nApprox);
 }
 
 float
 DBTable::getAve(size_t c) const
 {
-   int goodnum=0;
-   float sum=0.0;
-   for (size_t i=0 ; i<nRows() ; i++) {
-      if (_table[i][c] != INT_MAX) {
-         goodnum++;
-         sum+=_table[i][c];
-      } 
-   }
-   if (goodnum)
-      return sum/goodnum;
-   else 
-      return NAN;
-   // TODO: compute the average of data in column #c
+   const DBColAgg& a = _cols[c].stats();
+   return a._count? float(double(a._sum) / a._count): NAN;
 }
 
 void
-DBTable::sort(const struct DBSort& s)
+DBTable::printCol(size_t c, ostream& os) const
 {
-   for (size_t i=0 ; i<nRows() ; i++) {
-      for (size_t j=i ; j<nRows() ; j++) {
-         if (s(_table[i],_table[j]))
-            swap(_table[j],_table[j]);
+   const DBColumn& col = _cols[c];
+   int buf[DB_DECODE_ROWS];
+   bool first = true;
+   DBFormatter f(os);
+   for (size_t b = 0; b < _nRows; b += DB_DECODE_ROWS) {
+      size_t e = min(b + DB_DECODE_ROWS, _nRows);
+      const int* d = col.cells(b, e, buf);
+      for (size_t i = b; i < e; ++i) {
+         if (_dead.isDead(i)) continue;
+         if (!first)
+            f.put(' ');
+         first = false;
+         f.putCell(d[i - b]);
       }
    }
-   // TODO: sort the data according to the order of columns in 's'
-}
-
-void
-DBTable::printCol(size_t c) const
-{
-   for (size_t i=0 ; i<nRows() ; i++) {
-      if (_table[i][c]==INT_MAX)
-         cout << '.';
-      else
-         cout << _table[i][c];
-      if (i!=nRows()-1)
-         cout << ' ';
-   }
    // TODO: to print out a column.
    // - Data are seperated by a space. No trailing space at the end.
    // - Null cells are printed as '.'
 }
 
 void
-DBTable::printSummary() const
+DBTable::printSummary(ostream& os) const
 {
    size_t nr = nRows(), nc = nCols(), nv = 0;
-   for (size_t i = 0; i < nr; ++i)
-      for (size_t j = 0; j < nc; ++j)
-         if (_table[i][j] != INT_MAX) ++nv;
-   cout << "(#rows, #cols, #data) = (" << nr << ", " << nc << ", "
-        << nv << ")" << endl;
+   for (size_t j = 0; j < nc; ++j)
+      nv += _cols[j].nValid();
+   os << "(#rows, #cols, #data) = (" << nr << ", " << nc << ", "
+      << nv << ")" << endl;
+   if (!nr) return;
+   // memory of the cells vs. one int per cell
+   static const char* encName[] = { "plain", "FOR", "delta", "dict" };
+   size_t nBytes = 0;
+   ios_base::fmtflags origFlags = os.flags();
+   streamsize origPrec = os.precision();
+   os << fixed << setprecision(2);
+   for (size_t j = 0; j < nc; ++j) {
+      const DBColumn& col = _cols[j];
+      nBytes += col.cellBytes();
+      os << "Column " << j << ": " << encName[col.encoding()];
+      if (!col.isPlain()) os << " (" << col.encodedBits() << " bits)";
+      os << ", " << double(col.cellBytes()) / nr << " bytes/cell" << endl;
+   }
+   os << "Compression ratio: " << double(nr * nc * sizeof(int)) / nBytes
+      << " (" << double(nBytes) / (nr * nc) << " bytes/cell)" << endl;
+   if (_dead.size())
+      os << "Deleted rows: " << _dead.size() << " (not yet compacted)"
+         << endl;
+   os.flags(origFlags);
+   os.precision(origPrec);
 }
-
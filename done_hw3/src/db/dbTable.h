@@ -10,12 +10,21 @@
 
 #include <iostream>
 #include <fstream>
+#include <string>
 #include <vector>
 #include <cmath>
 #include <climits>
+#include <stdint.h>
+#include "dbKernel.h"
+#include "dbCodec.h"
 
 using namespace std;
 
+class DBTable;
+class DBFilter;
+
+// A DBRow is only used to build up a row (e.g. DBAppend -Row) before it
+// is handed over to the table; the table itself is stored by columns.
 class DBRow
 {
 public:
@@ -23,6 +32,7 @@ public:
    DBRow(const vector<int>& d) : _data(d) {}
 
    void reset() { vector<int> tmp; tmp.swap(_data); }
+   void clear() { _data.clear(); }  // keep the capacity for reuse
    int& operator [] (size_t i) { return _data[i]; }
    const int& operator [] (size_t i) const { return _data[i]; }
    void addData(int i) { /* TODO */_data.push_back(i); }
@@ -36,9 +46,290 @@ private:
    vector<int>   _data;
 };
 
+// A light-weight, read-only view of row #_row in a (column-major) DBTable.
+// _row is a physical row, i.e. it counts the deleted rows not yet compacted
+// (DBTable::operator [] takes the index among the live rows instead).
+// It is returned by value from DBTable::operator [] and must not outlive
+// the table or survive any change of the table shape.
+class DBRowView
+{
+public:
+   DBRowView(const DBTable& t, size_t r) : _table(t), _row(r) {}
+
+   inline int operator [] (size_t c) const;
+   inline size_t size() const;
+   bool empty() const { return size() == 0; }
+   size_t rowIdx() const { return _row; }
+
+   friend ostream& operator << (ostream& os, const DBRowView& r);
+
+private:
+   const DBTable&   _table;
+   size_t           _row;
+};
+
+// Zone map: the rows of a column are grouped into blocks ("zones") of
+// DB_ZONE_ROWS rows, and the min/max/#nulls of every zone are kept.
+#define DB_ZONE_BITS  16
+#define DB_ZONE_ROWS  (size_t(1) << DB_ZONE_BITS)
+
+struct DBZone
+{
+   DBZone() : _min(INT_MAX), _max(INT_MIN), _nNull(0), _dirty(true) {}
+
+   int        _min;     // INT_MAX if all nulls
+   int        _max;     // INT_MIN if all nulls
+   size_t     _nNull;
+   bool       _dirty;   // to be recomputed from the data before use
+};
+
+// Cached statistics of a column. Each entry is valid only while its version
+// equals the version of the column (DB_NO_VERSION: never computed).
+#define DB_NO_VERSION  size_t(-1)
+
+struct DBColStats
+{
+   DBColStats() : _aggVer(DB_NO_VERSION), _nDistinct(0),
+      _distinctVer(DB_NO_VERSION), _nApprox(0), _relErr(0),
+      _approxVer(DB_NO_VERSION) {}
+
+   DBColAgg   _agg;          // count/sum/min/max of the non-null cells
+   size_t     _aggVer;
+   size_t     _nDistinct;    // exact distinct count
+   size_t     _distinctVer;
+   size_t     _nApprox;      // HyperLogLog distinct count
+   double     _relErr;
+   size_t     _approxVer;
+};
+
+// Sorted (value, row) index of the non-null cells of a column, built by
+// DBIndex. It is rebuilt on the next use after the column changes.
+struct DBColIndex
+{
+   DBColIndex() : _on(false), _version(DB_NO_VERSION) {}
+
+   bool               _on;        // the column is indexed
+   size_t             _version;   // of the column when built
+   vector<int>        _keys;      // non-decreasing
+   vector<uint32_t>   _rows;      // row of _keys[i]; ties in row order
+};
+
+// Encodings of the cells of a column (see dbCodec.cpp). Except DB_ENC_PLAIN,
+// a column is read-only: it is decoded back to plain before any change.
+enum DBColEncoding
+{
+   DB_ENC_PLAIN = 0,   // one int per cell in _data
+   DB_ENC_FOR   = 1,   // frame of reference (min) + bit packing
+   DB_ENC_DELTA = 2,   // non-decreasing: packed deltas + per-block anchors
+                       //    + per-miniblock prefixes
+   DB_ENC_DICT  = 3    // low cardinality: packed codes into a dictionary
+};
+
+// One contiguous buffer per column plus a validity bitmap: bit (r % 64) of
+// _valid[r / 64] is set iff cell #r is not null. Null cells still hold
+// INT_MAX in _data so that getData() keeps its old meaning.
+// The zone map is updated in O(1) when a cell is added, and a zone is only
+// marked dirty when its min/max may have been removed; dirty zones are
+// recomputed lazily by zone().
+// _version is bumped by every change of the cells. An append updates the
+// cached aggregate in O(1); other changes (e.g. deletion) just leave the
+// cache stale, and it is recomputed on the next query.
+class DBColumn
+{
+public:
+   DBColumn() : _version(0), _enc(DB_ENC_PLAIN), _nEnc(0), _bits(0),
+      _base(0), _prefixBits(0) {}
+   DBColumn(size_t n) : _data(n, INT_MAX), _valid((n + 63) >> 6, 0),
+      _version(0), _enc(DB_ENC_PLAIN), _nEnc(0), _bits(0), _base(0),
+      _prefixBits(0) {
+      resetZones(); }
+   DBColumn(const vector<int>& d);
+
+   int operator [] (size_t r) const {
+      return _enc == DB_ENC_PLAIN? _data[r]: decodeAt(r); }
+   bool isNull(size_t r) const { return !((_valid[r >> 6] >> (r & 63)) & 1); }
+   // only for a plain column
+   const int* data() const { return _data.data(); }
+   const uint64_t* validity() const { return _valid.data(); }
+   size_t size() const { return _enc == DB_ENC_PLAIN? _data.size(): _nEnc; }
+   size_t nValid() const;
+
+   // encoding
+   DBColEncoding encoding() const { return _enc; }
+   bool isPlain() const { return _enc == DB_ENC_PLAIN; }
+   unsigned encodedBits() const { return _bits; }
+   size_t cellBytes() const;  // memory of the cells (bitmap excluded)
+   void encode();             // pick the smallest encoding
+   void decode();             // back to DB_ENC_PLAIN
+   // cells [b, e) into out[0, e - b); 'b' must be a multiple of 64
+   void decode(size_t b, size_t e, int* out) const;
+   // cells [b, e), in place if plain or else decoded into 'buf'
+   const int* cells(size_t b, size_t e, int* buf) const {
+      if (_enc == DB_ENC_PLAIN) return _data.data() + b;
+      decode(b, e, buf);
+      return buf;
+   }
+
+   // zone map
+   size_t nZones() const { return _zones.size(); }
+   size_t zoneBegin(size_t z) const { return z << DB_ZONE_BITS; }
+   size_t zoneEnd(size_t z) const {
+      size_t e = (z + 1) << DB_ZONE_BITS;
+      return e < size()? e: size(); }
+   const DBZone& zone(size_t z) const {
+      if (_zones[z]._dirty) refreshZone(z);
+      return _zones[z]; }
+   bool getMinMax(int& mn, int& mx) const;
+   // mark the zones of rows [b, e) dirty after writing them in place
+   void touch(size_t b, size_t e);
+
+   // cached statistics
+   size_t version() const { return _version; }
+   bool hasIndex() const { return _index._on; }
+   const DBColAgg& stats() const;
+
+   // f(r, d) for every non-null cell d (row #r) of zone #z in the row
+   // order, decoded block by block; nothing to do for an all-null zone.
+   template <class F> void forEachValid(size_t z, F f) const {
+      size_t zb = zoneBegin(z), ze = zoneEnd(z);
+      if (zone(z)._nNull == ze - zb) return;
+      int buf[DB_DECODE_ROWS];
+      for (size_t b = zb; b < ze; b += DB_DECODE_ROWS) {
+         size_t e = b + DB_DECODE_ROWS < ze? b + DB_DECODE_ROWS: ze;
+         const int* d = cells(b, e, buf);
+         for (size_t i = b; i < e; ++i)
+            if (!isNull(i)) f(i, d[i - b]);
+      }
+   }
+   // ... and of the whole column
+   template <class F> void forEachValid(F f) const {
+      for (size_t z = 0, nz = nZones(); z < nz; ++z) forEachValid(z, f); }
+
+   void push(int d) {
+      if (_enc != DB_ENC_PLAIN) decode();
+      size_t r = _data.size();
+      if (!(r & 63)) _valid.push_back(0);
+      if (d != INT_MAX) _valid[r >> 6] |= uint64_t(1) << (r & 63);
+      _data.push_back(d);
+      if (!(r & (DB_ZONE_ROWS - 1))) {
+         _zones.push_back(DBZone());
+         _zones.back()._dirty = false;
+      }
+      zoneAdd(r >> DB_ZONE_BITS, d);
+      if (_stats._aggVer == _version && d != INT_MAX) {
+         DBColAgg& a = _stats._agg;
+         ++a._count; a._sum += d;
+         if (d < a._min) a._min = d;
+         if (d > a._max) a._max = d;
+      }
+      bump(true, d == INT_MAX);  // a null changes no distinct count
+   }
+   // n cells d[0], d[stride], d[2 * stride]... at the end
+   void append(const int* d, size_t n, size_t stride = 1);
+   void set(size_t r, int d);
+   void reserve(size_t n) {
+      if (_enc != DB_ENC_PLAIN) decode();
+      _data.reserve(n); _valid.reserve((n + 63) >> 6); }
+   void resize(size_t n);
+   void erase(size_t r);
+   void paste(size_t r, const DBColumn& s);
+   void permute(const vector<uint32_t>& order);
+   void kill(size_t r);
+   void reset();
+
+private:
+   friend class DBTable;   // for writing the cells in place when loading
+
+   vector<int>              _data;
+   vector<uint64_t>         _valid;
+   mutable vector<DBZone>   _zones;
+   size_t                   _version;
+   mutable DBColStats       _stats;
+   // encoded cells, if _enc != DB_ENC_PLAIN (then _data is empty)
+   DBColEncoding            _enc;
+   size_t                   _nEnc;     // #cells
+   unsigned                 _bits;     // bits per packed value
+   int                      _base;     // DB_ENC_FOR: frame of reference
+   vector<uint64_t>         _packed;
+   vector<int>              _aux;      // dictionary or anchors
+   // DB_ENC_DELTA: the packed prefix of every miniblock from its anchor
+   unsigned                 _prefixBits;
+   vector<uint64_t>         _prefix;
+   mutable DBColIndex       _index;
+
+   int decodeAt(size_t r) const;
+   uint32_t prefixAt(size_t i) const;
+
+   void zoneAdd(size_t z, int d) {
+      DBZone& zn = _zones[z];
+      if (d == INT_MAX) ++zn._nNull;
+      else {
+         if (d < zn._min) zn._min = d;
+         if (d > zn._max) zn._max = d;
+      }
+   }
+   void zoneRemove(size_t z, int d) {
+      DBZone& zn = _zones[z];
+      if (d == INT_MAX) --zn._nNull;
+      else if (d == zn._min || d == zn._max) zn._dirty = true;
+   }
+   void resetZones();
+   void refreshZone(size_t z) const;
+   void aggregate(size_t b, size_t e, DBColAgg& a) const;
+   // Move on to a new version; the cached aggregate (and distinct counts)
+   // stay valid if 'keepAgg' (and 'keepDistinct') and they were valid.
+   void bump(bool keepAgg, bool keepDistinct = false) {
+      size_t v = _version++;
+      if (keepAgg && _stats._aggVer == v) _stats._aggVer = _version;
+      if (keepDistinct) {
+         if (_stats._distinctVer == v) _stats._distinctVer = _version;
+         if (_stats._approxVer == v) _stats._approxVer = _version;
+      }
+   }
+};
+
+// One group of DBTable::group(): the aggregate of the rows with one key
+struct DBGroup
+{
+   DBGroup() : _key(INT_MAX) {}
+
+   int        _key;    // INT_MAX for the null key
+   DBColAgg   _agg;
+};
+
+// Tombstones of the deleted rows of a DBTable: a bitmap of the dead rows,
+// plus a Fenwick tree of #dead rows per block of DB_DEAD_ROWS rows, so that
+// the physical row of the k-th live row is found in O(log n), or in O(1)
+// while no row is dead.
+#define DB_DEAD_BITS  12
+#define DB_DEAD_ROWS  (size_t(1) << DB_DEAD_BITS)
+
+class DBDeadRows
+{
+public:
+   DBDeadRows() : _n(0) {}
+
+   size_t size() const { return _n; }
+   bool isDead(size_t r) const {
+      size_t w = r >> 6;
+      return w < _bits.size() && ((_bits[w] >> (r & 63)) & 1); }
+   void kill(size_t r);
+   size_t find(size_t k) const { return _n? search(k): k; }
+   void reset();
+   void swap(DBDeadRows& d) {
+      _bits.swap(d._bits); _tree.swap(d._tree); std::swap(_n, d._n); }
+
+private:
+   vector<uint64_t>   _bits;
+   vector<uint32_t>   _tree;   // 1-based; _tree[0] is unused
+   size_t             _n;
+
+   size_t search(size_t k) const;
+};
+
 struct DBSort
 {
-   bool operator() (const DBRow& r1, const DBRow& r2) const;
+   bool operator() (const DBRowView& r1, const DBRowView& r2) const;
    void pushOrder(size_t i) { _sortOrder.push_back(i); }
    vector<size_t> _sortOrder;
 };
@@ -46,45 +337,104 @@ struct DBSort
 class DBTable
 {
 public:
+   DBTable() : _nRows(0) {}
+
    void reset();
+   void swap(DBTable& t) {
+      _cols.swap(t._cols); std::swap(_nRows, t._nRows); _dead.swap(t._dead); }
    // access functions for row/column
-   const DBRow& operator [] (size_t i) const { return _table[i]; }
-   void addRow(const DBRow& r) { _table.push_back(r); }
-   void addCol(const vector<int>& d);
+   DBRowView operator [] (size_t i) const {
+      return DBRowView(*this, _dead.find(i)); }
+   const DBColumn& getCol(size_t c) const { return _cols[c]; }
+   void addRow(const DBRow& r);
+   // false (and no change) if 'd' is longer than the table
+   bool addCol(const vector<int>& d);
+   // n rows of 'nCols' cells each in 'cells' (row-major); as in addRow(),
+   // the first rows of an empty table decide #columns
+   void addRows(const int* cells, size_t n, size_t nCols);
+   // the lines of a csv fragment [b, e); return #rows appended
+   size_t addCsv(const char* b, const char* e);
    void delRow(int c);
    void delCol(int c);
+   // drop the storage of the deleted rows
+   void compact();
+   size_t nDeleted() const { return _dead.size(); }
    // check whether the table is empty or not-empty
-   bool operator !() { return _table.empty(); }
-   operator void* () const { return _table.empty()? NULL: (void*)this; }
+   bool operator !() { return nRows() == 0; }
+   operator void* () const { return nRows() == 0? NULL: (void*)this; }
    //number of rows/columns
-   size_t nRows() const { return _table.size(); }
-   size_t nCols() const { /* TODO */ return _table[0].size(); }
-   // "getXXX" functions
-   int getData(size_t r, size_t c) const { return _table[r][c]; }
+   size_t nRows() const { return _nRows - _dead.size(); }
+   size_t nCols() const { return _cols.size(); }
+   // "getXXX" functions; 'r' is a physical row (see DBRowView)
+   int getData(size_t r, size_t c) const { return _cols[c][r]; }
    float getMax(size_t c) const;
    float getMin(size_t c) const;
-   float getSum(size_t c) const;
+   long long getSum(size_t c, bool& allNull) const;
    int getCount(size_t c) const;
+   int getApproxCount(size_t c, double& relErr) const;
    float getAve(size_t c) const;
 
    void sort(const struct DBSort& s);
 
    // printing functions
-   void printCol(size_t c) const;
-   void printSummary() const;
+   void printCol(size_t c, ostream& os = cout) const;
+   void printSummary(ostream& os = cout) const;
 
    static void printData(ostream& os, int i, bool printNull = false) {
       if (i == INT_MAX) os << (printNull? "null":".");
       else os << i;
    }
 
+   // read a csv file by mmap() with 'nThreads' parsing threads; the rows
+   // are appended to the table. 'nBytes' returns the file size.
+   bool readCsv(const string& fileName, size_t nThreads, size_t& nBytes);
+   // binary snapshot (see dbSnapshot.cpp); 'nBytes' returns the file size
+   bool save(const string& fileName, bool compress, size_t& nBytes) const;
+   bool load(const string& fileName, size_t nThreads, size_t& nBytes);
+
+   // secondary index and range selection (see dbIndex.cpp)
+   void buildIndex(size_t c);
+   bool hasIndex(size_t c) const { return _cols[c].hasIndex(); }
+   bool select(size_t c, int lo, int hi, vector<uint32_t>& rows) const;
+   void aggregate(size_t c, const vector<uint32_t>& rows, DBColAgg& a) const;
+   size_t countDistinct(size_t c, const vector<uint32_t>& rows) const;
+   // hash group-by (see dbGroup.cpp)
+   void group(size_t kc, size_t ac, vector<DBGroup>& groups,
+              size_t nThreads) const;
+   // radix-partitioned hash join into this table (see dbJoin.cpp)
+   bool join(const DBTable& a, size_t ac, const DBTable& b, size_t bc,
+             size_t memBudget, size_t& nSpilled);
+   // top-k and quantiles of the non-null cells (see dbQuantile.cpp)
+   void top(size_t c, size_t k, vector<uint32_t>& rows) const;
+   bool quantiles(size_t c, const vector<double>& p, vector<int>& q) const;
+   bool approxQuantiles(size_t c, const vector<double>& p, vector<int>& q,
+                        double& rankErr) const;
+   // rows satisfying a filter expression (see dbFilter.cpp)
+   void filter(const DBFilter& f, vector<uint32_t>& rows) const;
+   // replace this table by the rows 'rows' (e.g. from filter()) of 't'
+   void gather(const DBTable& t, const vector<uint32_t>& rows);
+
    friend ifstream& operator >> (ifstream& ifs, DBTable& t);
    friend ostream& operator << (ostream& os, const DBTable& t);
+   friend class DBBench;   // drops the cached statistics (see dbBench.cpp)
 
 private:
-   vector<DBRow>    _table;
+   vector<DBColumn>  _cols;
+   size_t            _nRows;   // including the deleted rows
+   DBDeadRows        _dead;
 
    // Helper functions; You are welcome to define on your own
+   void initCols(const char* b, const char* e);
+   static size_t parseCsv(const char* b, const char* e,
+                          vector<DBColumn>& cols, size_t r);
+   void refreshIndex(size_t c) const;
+   void radixSort(const DBSort& s, vector<uint32_t>& order,
+                  size_t nThreads) const;
+   void mergeSort(const DBSort& s, vector<uint32_t>& order,
+                  size_t nThreads) const;
 };
 
+int DBRowView::operator [] (size_t c) const { return _table.getData(_row, c); }
+size_t DBRowView::size() const { return _table.nCols(); }
+
 #endif // DB_TABLE_H
@@ -0,0 +1,44 @@
+/****************************************************************************
+  FileName     [ dbThread.h ]
+  PackageName  [ db ]
+  Synopsis     [ Define a simple parallel-for over a pool of threads ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2015-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+#ifndef DB_THREAD_H
+#define DB_THREAD_H
+
+#include <vector>
+#include <thread>
+#include <atomic>
+
+using namespace std;
+
+// #threads to use when the user does not say so
+inline size_t dbDefaultThreads()
+{
+   size_t n = thread::hardware_concurrency();
+   return n? n: 1;
+}
+
+// Run task(0), task(1), ..., task(n - 1) on a pool of up to 'nThreads'
+// threads, the calling thread included. The tasks are handed out in order
+// through an atomic counter, so a pool thread that finishes early simply
+// takes the next task. Return after all the tasks are done.
+template <class F>
+void dbParallelFor(size_t n, size_t nThreads, const F& task)
+{
+   if (nThreads > n) nThreads = n;
+   if (nThreads <= 1) {
+      for (size_t i = 0; i < n; ++i) task(i);
+      return;
+   }
+   atomic<size_t> next(0);
+   auto worker = [&]() { for (size_t i; (i = next++) < n; ) task(i); };
+   vector<thread> pool;
+   for (size_t t = 1; t < nThreads; ++t) pool.push_back(thread(worker));
+   worker();
+   for (size_t t = 0, m = pool.size(); t < m; ++t) pool[t].join();
+}
+
+#endif // DB_THREAD_H
@@ -50,7 +50,11 @@ main(int argc, char** argv)
    cin >> cmd;
    cout << "MAX of col " << cmd << " = " << dbtbl.getMax(cmd) << endl; 
    cout << "MIN of col " << cmd << " = " << dbtbl.getMin(cmd) << endl; 
-   cout << "SUM of col " << cmd << " = " << dbtbl.getSum(cmd) << endl; 
+   bool allNull;
+   long long sum = dbtbl.getSum(cmd, allNull);
+   cout << "SUM of col " << cmd << " = ";
+   if (allNull) cout << float(NAN) << endl;
+   else cout << sum << endl;
    cout << "CNT of col " << cmd << " = " << dbtbl.getCount(cmd) << endl;
    cout << "AVE of col " << cmd << " = " << dbtbl.getAve(cmd)  << endl;
    cout << "PRINT COL " << endl ;
@@ -1,4 +1,7 @@
-util.d: ../../include/util.h 
+util.d: ../../include/util.h ../../include/rnGen.h 
 ../../include/util.h: util.h
 	@rm -f ../../include/util.h
 	@ln -fs ../src/util/util.h ../../include/util.h
+../../include/rnGen.h: rnGen.h
+	@rm -f ../../include/rnGen.h
+	@ln -fs ../src/util/rnGen.h ../../include/rnGen.h
@@ -22,7 +22,10 @@ initMemCmd()
    if (!(cmdMgr->regCmd("MTReset", 3, new MTResetCmd) &&
          cmdMgr->regCmd("MTNew", 3, new MTNewCmd) &&
          cmdMgr->regCmd("MTDelete", 3, new MTDeleteCmd) &&
-         cmdMgr->regCmd("MTPrint", 3, new MTPrintCmd)
+         cmdMgr->regCmd("MTPrint", 3, new MTPrintCmd) &&
+         cmdMgr->regCmd("MTStat", 3, new MTStatCmd) &&
+         cmdMgr->regCmd("MTTrim", 3, new MTTrimCmd) &&
+         cmdMgr->regCmd("MTThread", 4, new MTThreadCmd)
       )) {
       cerr << "Registering \"mem\" commands fails... exiting" << endl;
       return false;
@@ -263,3 +266,120 @@ MTPrintCmd::help() const
 }
 
 
+//----------------------------------------------------------------------
+//    MTStat
+//----------------------------------------------------------------------
+CmdExecStatus
+MTStatCmd::exec(const string& option)
+{
+   // check option
+   if (option.size())
+      return CmdExec::errorOption(CMD_OPT_EXTRA, option);
+   mtest.printStats();
+
+   return CMD_EXEC_DONE;
+}
+
+void
+MTStatCmd::usage(ostream& os) const
+{  
+   os << "Usage: MTStat" << endl;
+}
+
+void
+MTStatCmd::help() const
+{  
+   cout << setw(15) << left << "MTStat: " 
+        << "(memory test) print memory manager statistics" << endl;
+}
+
+
+//----------------------------------------------------------------------
+//    MTTrim [-HighWater (size_t freeBytes)]
+//----------------------------------------------------------------------
+CmdExecStatus
+MTTrimCmd::exec(const string& option)
+{
+   // check option
+   vector<string> options;
+   if (!CmdExec::lexOptions(option, options))
+      return CMD_EXEC_ERROR;
+   if (options.empty()) {
+      cout << "Released " << mtest.trim() << " Bytes to the OS." << endl;
+      return CMD_EXEC_DONE;
+   }
+   if (myStrNCmp("-HighWater", options[0], 2) != 0)
+      return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[0]);
+   if (options.size() == 1)
+      return CmdExec::errorOption(CMD_OPT_MISSING, options[0]);
+   int b;
+   if (!myStr2Int(options[1], b) || b < 0)
+      return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[1]);
+   if (options.size() > 2)
+      return CmdExec::errorOption(CMD_OPT_EXTRA, options[2]);
+   mtest.setHighWater(b);
+   return CMD_EXEC_DONE;
+}
+
+void
+MTTrimCmd::usage(ostream& os) const
+{  
+   os << "Usage: MTTrim [-HighWater (size_t freeBytes)]" << endl;
+}
+
+void
+MTTrimCmd::help() const
+{  
+   cout << setw(15) << left << "MTTrim: " 
+        << "(memory test) give free memory back to the OS" << endl;
+}
+
+
+
+
+//----------------------------------------------------------------------
+//    MTThread <(size_t numThreads)> [(size_t numOps)] [-Cross]
+//----------------------------------------------------------------------
+CmdExecStatus
+MTThreadCmd::exec(const string& option)
+{
+   // check option
+   vector<string> options;
+   if (!CmdExec::lexOptions(option, options))
+      return CMD_EXEC_ERROR;
+   if (options.empty())
+      return CmdExec::errorOption(CMD_OPT_MISSING, "");
+   bool cross = false;
+   if (myStrNCmp("-Cross", options.back(), 2) == 0) {
+      cross = true;
+      options.pop_back();
+      if (options.empty())
+         return CmdExec::errorOption(CMD_OPT_MISSING, "");
+   }
+   int nThreads, nOps = 100000;
+   if (!myStr2Int(options[0], nThreads) || nThreads <= 0)
+      return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[0]);
+   if (options.size() > 1 && (!myStr2Int(options[1], nOps) || nOps <= 0))
+      return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[1]);
+   if (options.size() > 2)
+      return CmdExec::errorOption(CMD_OPT_EXTRA, options[2]);
+   size_t nBad = mtest.stress(nThreads, nOps, cross);
+   cout << nThreads << " threads x " << nOps << " operations"
+        << (cross? " (freed by other threads)": "") << ": " << nBad
+        << " corrupted objects/arrays" << endl;
+   return CMD_EXEC_DONE;
+}
+
+void
+MTThreadCmd::usage(ostream& os) const
+{  
+   os << "Usage: MTThread <(size_t numThreads)> [(size_t numOps)] [-Cross]"
+      << endl;
+}
+
+void
+MTThreadCmd::help() const
+{  
+   cout << setw(15) << left << "MTThread: " 
+        << "(memory test) stress the memory manager by threads" << endl;
+}
@@ -14,5 +14,8 @@ CmdClass(MTResetCmd);
 CmdClass(MTNewCmd);
 CmdClass(MTDeleteCmd);
 CmdClass(MTPrintCmd);
+CmdClass(MTStatCmd);
+CmdClass(MTTrimCmd);
+CmdClass(MTThreadCmd);
 
 #endif // MEM_CMD_H
@@ -13,6 +13,12 @@
 #include <iostream>
 #include <iomanip>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <map>
 
 using namespace std;
 
@@ -33,6 +39,9 @@ public:                                                                     \
    void  operator delete[](void* p) { _memMgr->freeArr((T*)p); }            \
    static void memReset(size_t b = 0) { _memMgr->reset(b); }                \
    static void memPrint() { _memMgr->print(); }                             \
+   static MemStats memStats() { return _memMgr->getStats(); }               \
+   static size_t memTrim() { return _memMgr->trim(); }                      \
+   static void memHighWater(size_t b) { _memMgr->setHighWater(b); }         \
 private:                                                                    \
    static MemMgr<T>* const _memMgr
 
@@ -56,11 +65,32 @@ private:                                                                    \
 // R_SIZE is the size of the recycle list
 #define R_SIZE 256
 
+// MEM_MAG_SIZE is the capacity of the per-thread magazine (MemMagazine);
+// single objects move between a magazine and MemMgr in batches of half of it
+#define MEM_MAG_SIZE 64
+
 //--------------------------------------------------------------------------
 // Forward declarations
 //--------------------------------------------------------------------------
 template <class T> class MemMgr;
 
+// Statistics of a MemMgr since its last reset(), by MemMgr::getStats()
+// in O(#threads) time
+struct MemStats
+{
+   size_t   _blockSize;
+   size_t   _numBlocks;
+   size_t   _bytesInUse;      // by the objects and arrays not deleted
+   size_t   _numLargeArrs;    // arrays larger than a MemBlock, each mapped
+   size_t   _largeBytes;      //    on its own (in _bytesInUse, too)
+   size_t   _peakBytesInUse;  // sampled on refills, new[] and getStats()
+   size_t   _numRecycled;     // #free objects/arrays in the recycle lists
+   size_t   _numCached;       // #free objects in the magazines
+   size_t   _numRecycleHits;  // #objects/arrays reused from a recycle list
+   size_t   _numBlockAllocs;  // #objects/arrays cut from a MemBlock
+   size_t   _bytesReleased;   // given back to the OS by MemMgr::trim()
+};
+
 
 //--------------------------------------------------------------------------
 // Class Definitions
@@ -76,12 +106,23 @@ class MemBlock
    friend class MemMgr<T>;
 
    // Constructor/Destructor
-   MemBlock(MemBlock<T>* n, size_t b) : _nextBlock(n) {
-      _begin = _ptr = new char[b]; _end = _begin + b; }
-   ~MemBlock() { delete [] _begin; }
+   // The memory is mapped directly, so that MemMgr::trim() can give it back
+   // to the OS
+   MemBlock(MemBlock<T>* n, size_t b) : _nextBlock(n), _nLive(0) {
+      void* p = mmap(0, b, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                     -1, 0);
+      if (p == MAP_FAILED) throw bad_alloc();
+      _begin = _ptr = (char*)p; _end = _begin + b; }
+   ~MemBlock() { munmap(_begin, getSize()); }
 
    // Member functions
-   void reset() { _ptr = _begin; }
+   void reset() { _ptr = _begin; _nLive = 0; }
+   // reset(), and let the OS drop the pages used so far (they read as 0
+   // when touched again)
+   void release() {
+      madvise(_begin, _ptr - _begin, MADV_DONTNEED);
+      reset();
+   }
    // 1. Get (at least) 't' bytes memory from current block
    //    Promote 't' to a multiple of SIZE_T
    // 2. Update "_ptr" accordingly
@@ -99,6 +140,9 @@ class MemBlock
       }   
    }
    size_t getRemainSize() const { return size_t(_end - _ptr); }
+   size_t getSize() const { return size_t(_end - _begin); }
+   bool contains(const void* p) const {
+      return (const char*)p >= _begin && (const char*)p < _end; }
       
    MemBlock<T>* getNextBlock() const { return _nextBlock; }
 
@@ -107,6 +151,8 @@ class MemBlock
    char*             _ptr;
    char*             _end;
    MemBlock<T>*      _nextBlock;
+   size_t            _nLive;   // #objects/arrays cut from it and not in
+                               // a recycle list; kept by MemMgr
 };
 
 // Make it a private class;
@@ -118,7 +164,8 @@ class MemRecycleList
    friend class MemMgr<T>;
 
    // Constructor/Destructor
-   MemRecycleList(size_t a = 0) : _arrSize(a), _first(0), _nextList(0) {}
+   MemRecycleList(size_t a = 0)
+      : _arrSize(a), _first(0), _nextList(0), _numElm(0) {}
    ~MemRecycleList() { reset(); }
 
    // Member functions
@@ -131,27 +178,28 @@ class MemRecycleList
       // TODO
       T* ret = _first;
       _first = this->getNext(_first);
+      --_numElm;
       return ret;
    }
    // push the element 'p' to the beginning of the recycle list
    void  pushFront(T* p) {
       *(T**)p = _first;
       _first = p;
+      ++_numElm;
       // TODO
    }
    // Release the memory occupied by the recycle list(s)
    // DO NOT release the memory occupied by MemMgr/MemBlock
-   void reset() {
-      // TODO
-      int n = numElm();
-         for (int i=0 ; i<n ; i++) {
-            T* ret = _first;
-            _first = this->getNext(_first);
-            ret = NULL;              //////how to delete;
-            /////////////////////////////////////////////
-            //problematic code in here!!!!!!!!!!!!!!!!!//
-            /////////////////////////////////////////////
-         }
+   // The elements are in the MemBlocks, so there is nothing to free
+   void reset() { _first = 0; _numElm = 0; }
+   // Remove the elements 'p' with f(p) true; return #elements removed
+   template <class F> size_t removeIf(F f) {
+      size_t n = 0;
+      for (T** pp = &_first; *pp; )
+         if (f(*pp)) { *pp = getNext(*pp); ++n; }
+         else pp = (T**)*pp;
+      _numElm -= n;
+      return n;
    }
 
    // Helper functions
@@ -163,21 +211,42 @@ class MemRecycleList
    }
    //
    // count the number of elements in the recycle list
-   size_t numElm() const {
-      size_t count = 0;
-      T* p = _first;
-      while (p) {
-         p = getNext(p);
-         ++count;
-      }
-      return count;
-   }
+   size_t numElm() const { return _numElm; }
 
    // Data members
    size_t              _arrSize;   // the array size of the recycled data
    T*                  _first;     // the first recycled data
    MemRecycleList<T>*  _nextList;  // next MemRecycleList
                                    //      with _arrSize + x*R_SIZE
+   size_t              _numElm;    // kept by popFront()/pushFront()
+};
+
+// Make it a private class;
+// Only friend to MemMgr;
+//
+// The cache of free single objects of a thread in front of a MemMgr<T>,
+// so that new/delete of an object usually takes no lock. It is created on
+// the first use of MemMgr::alloc()/free() by a thread, and its objects go
+// back to the MemMgr when the thread exits.
+template <class T>
+class MemMagazine
+{
+   friend class MemMgr<T>;
+
+   // Constructor/Destructor
+   MemMagazine() : _mgr(0), _n(0) {}
+   ~MemMagazine() { if (_mgr) _mgr->detach(*this); }
+
+   // Member functions
+   // ----------------
+   // _n is only changed by its thread, but read by MemMgr::print()
+   size_t size() const { return _n.load(memory_order_relaxed); }
+   void setSize(size_t n) { _n.store(n, memory_order_relaxed); }
+
+   // Data members
+   MemMgr<T>*        _mgr;     // 0 if not attached to any MemMgr
+   atomic<size_t>    _n;       // #objects in _objs[]
+   T*                _objs[MEM_MAG_SIZE];
 };
 
 template <class T>
@@ -185,13 +254,19 @@ class MemMgr
 {
    const int S = sizeof(T);
 public:
-   MemMgr(size_t b = 65536) : _blockSize(b) {
+   MemMgr(size_t b = 65536)
+      : _blockSize(b), _largeBytes(0), _highWater(0), _trimAt(0) {
       assert(b % SIZE_T == 0);
-      _activeBlock = new MemBlock<T>(0, _blockSize);
+      _activeBlock = newBlock(0, _blockSize);
       for (int i = 0; i < R_SIZE; ++i)
          _recycleList[i]._arrSize = i;
+      resetStats();
+   }
+   ~MemMgr() {
+      reset();
+      deleteBlock(_activeBlock);
+      for (size_t i = 0, n = _mags.size(); i < n; ++i) _mags[i]->_mgr = 0;
    }
-   ~MemMgr() { reset(); delete _activeBlock; }
 
    // 1. Remove the memory of all but the firstly allocated MemBlocks
    //    That is, the last MemBlock searchd from _activeBlock.
@@ -200,8 +275,13 @@ public:
    // 3. 'b' is the new _blockSize; "b = 0" means _blockSize does not change
    //    if (b != _blockSize) reallocate the memory for the first MemBlock
    // 4. Update the _activeBlock pointer
+   // 5. Unmap the large arrays
+   // [Note] No other thread may use the MemMgr meanwhile; all the
+   //        magazines are emptied.
    void reset(size_t b = 0) {
       assert(b % SIZE_T == 0);
+      lock_guard<mutex> lock(_mutex);
+      for (size_t i = 0, n = _mags.size(); i < n; ++i) _mags[i]->setSize(0);
       //#ifdef MEM_DEBUG
       //cout << "Resetting memMgr...(" << b << ")" << endl;
       //#endif // MEM_DEBUG
@@ -209,7 +289,7 @@ public:
       MemBlock<T>* tempblock = _activeBlock;
       while (_activeBlock->getNextBlock() != 0) {
          tempblock = _activeBlock->getNextBlock();
-         delete _activeBlock;
+         deleteBlock(_activeBlock);
          _activeBlock = tempblock;
       }
       _activeBlock->reset();
@@ -217,40 +297,69 @@ public:
       for (int i=0 ; i<R_SIZE ; i++)  {
          MemRecycleList<T>* ll = &(_recycleList[i]);
          while (ll != 0)  {
-            if (ll->numElm() >0 ) 
-               ll->reset();
+            ll->reset();
             ll = ll->getNextList();
          }
       }
+      for (typename map<const T*, size_t>::iterator it = _largeArrs.begin();
+           it != _largeArrs.end(); ++it)
+         munmap((void*)it->first, it->second);
+      _largeArrs.clear();
+      _largeBytes = 0;
+      resetStats();
+      _trimAt = _highWater;
 
       if (b != 0) {
          _blockSize = b;
-         _activeBlock->_end = _activeBlock->_begin + b;
+         if (b != _activeBlock->getSize()) {
+            deleteBlock(_activeBlock);
+            _activeBlock = newBlock(0, b);
+         }
       }
 
    }
    // Called by new
+   // From the magazine of the calling thread, refilled if empty
    T* alloc(size_t t) {
       assert(t == S);
       //#ifdef MEM_DEBUG
       //cout << "Calling alloc...(" << t << ")" << endl;
       //#endif // MEM_DEBUG
-      return getMem(t);
+      MemMagazine<T>& m = magazine();
+      size_t n = m.size();
+      if (!n) n = refill(m);
+      m.setSize(--n);
+      return m._objs[n];
    }
    // Called by new[]
+   // An array larger than a MemBlock gets memory of its own
    T* allocArr(size_t t) {
       //#ifdef MEM_DEBUG
       //cout << "Calling allocArr...(" << t << ")" << endl;
       //#endif // MEM_DEBUG
       // Note: no need to record the size of the array == > system will do
-      return getMem(t);
+      lock_guard<mutex> lock(_mutex);
+      size_t s = toSizeT(t);
+      if (s > _blockSize) return getLargeMem(s);
+      T* ret = getMem(t);
+      _bytesOut += toSizeT(t);
+      sampleUse();
+      return ret;
    }
    // Called by delete
+   // To the magazine of the calling thread, half flushed if full
    void  free(T* p) {
       //#ifdef MEM_DEBUG
       //cout << "Calling free...(" << p << ")" << endl;
       //#endif // MEM_DEBUG
-      getMemRecycleList(0)->pushFront(p);
+      MemMagazine<T>& m = magazine();
+      size_t n = m.size();
+      if (n == MEM_MAG_SIZE) {
+         lock_guard<mutex> lock(_mutex);
+         n = flush(m, MEM_MAG_SIZE / 2);
+      }
+      m._objs[n] = p;
+      m.setSize(n + 1);
    }
    // Called by delete[]
    void  freeArr(T* p) {
@@ -258,10 +367,14 @@ public:
       //cout << "Calling freeArr...(" << p << ")" << endl;
       //#endif // MEM_DEBUG
       // TODO
+      lock_guard<mutex> lock(_mutex);
+      if (!_largeArrs.empty() && freeLargeMem(p)) return;
       // Get the array size 'n' stored by system,
       // which is also the _recycleList index
-      size_t n = *(size_t*)p;
-      getMemRecycleList(n)->pushFront(p);
+      size_t n = *(size_t*)p, t = n * S + SIZE_T;
+      recycle(getMemRecycleList(n), p);
+      _bytesOut -= toSizeT(t);
+      checkTrim();
       //#ifdef MEM_DEBUG
       //cout << ">> Array size = " << n << endl;
       //cout << "Recycling " << p << " to _recycleList[" << n << "]" << endl;
@@ -269,6 +382,8 @@ public:
       // add to recycle list...
    }
    void print() const {
+      lock_guard<mutex> lock(_mutex);
+      size_t nCached = numCached();
       cout << "=========================================" << endl
            << "=              Memory Manager           =" << endl
            << "=========================================" << endl
@@ -276,6 +391,10 @@ public:
            << "* Number of blocks      : " << getNumBlocks() << endl
            << "* Free mem in last block: " << _activeBlock->getRemainSize()
            << endl
+           << "* Large arrays          : " << _largeArrs.size() << " ("
+           << _largeBytes << " Bytes)" << endl
+           << "* Objects in magazines  : " << nCached << " (" << _mags.size()
+           << " threads)" << endl
            << "* Recycle list          : " << endl;
       int i = 0, count = 0;
       while (i < R_SIZE) {
@@ -294,10 +413,67 @@ public:
       cout << endl;
    }
 
+   MemStats getStats() const {
+      lock_guard<mutex> lock(_mutex);
+      MemStats st;
+      size_t s = toSizeT(S);
+      st._blockSize = _blockSize;
+      st._numBlocks = getNumBlocks();
+      st._numCached = numCached();
+      st._bytesInUse = _bytesOut - st._numCached * s + _largeBytes;
+      st._numLargeArrs = _largeArrs.size();
+      st._largeBytes = _largeBytes;
+      if (st._bytesInUse > _peakBytes) _peakBytes = st._bytesInUse;
+      st._peakBytesInUse = _peakBytes;
+      st._numRecycled = _numRecycled;
+      st._numRecycleHits = _numRecycleHits;
+      st._numBlockAllocs = _numBlockAllocs;
+      st._bytesReleased = _bytesReleased;
+      return st;
+   }
+
+   // Give the MemBlocks with no live objects/arrays back to the OS, after
+   // flushing the magazine of the calling thread; the objects in the other
+   // magazines are live. Return #Bytes released.
+   size_t trim() {
+      MemMagazine<T>& m = magazine();
+      lock_guard<mutex> lock(_mutex);
+      size_t nBytes = _bytesReleased;
+      flush(m, m.size());   // may trim already by the high-water policy
+      trimBlocks();
+      return _bytesReleased - nBytes;
+   }
+   // Trim automatically whenever the free memory in the MemBlocks exceeds
+   // 'b' Bytes; "b = 0" turns it off
+   void setHighWater(size_t b) {
+      lock_guard<mutex> lock(_mutex);
+      _highWater = _trimAt = b;
+   }
+
 private:
+   friend class MemMagazine<T>;
+
    size_t                     _blockSize;
    MemBlock<T>*               _activeBlock;
    MemRecycleList<T>          _recycleList[R_SIZE];
+   // _mutex guards all the data members except the contents of _mags[]
+   mutable mutex              _mutex;
+   vector<MemMagazine<T>*>    _mags;    // the magazines of all threads
+
+   // all the MemBlocks by _begin, to find the one of an address
+   map<const char*, MemBlock<T>*>  _blocks;
+   map<const T*, size_t>      _largeArrs;  // the large arrays and their Bytes
+   size_t                     _largeBytes;
+   size_t                     _highWater;  // see setHighWater()
+   size_t                     _trimAt;     // free Bytes to trim at
+
+   // for getStats(); see MemStats
+   size_t                     _numRecycled;
+   size_t                     _numRecycleHits;
+   size_t                     _numBlockAllocs;
+   size_t                     _bytesOut;   // in use or in the magazines
+   mutable size_t             _peakBytes;
+   size_t                     _bytesReleased;
 
    // Private member functions
    //
@@ -352,11 +528,7 @@ private:
       // 1. Make sure to promote t to a multiple of SIZE_T
       t = toSizeT(t);
       
-      if (t > _blockSize)  {
-         cerr << "Requested memory (" << t << ") is greater than block size"
-         << "(" << _blockSize << "). " << "Exception raised...\n";
-         throw bad_alloc();
-      }
+      assert(t <= _blockSize);
  
 
 
@@ -368,8 +540,8 @@ private:
       //      cerr << "Requested memory (" << t << ") is greater than block size"
       //      << "(" << _blockSize << "). " << "Exception raised...\n";
       //}
-      // 2. Check if the requested memory is greater than the block size.
-      //    If so, throw a "bad_alloc()" exception.
+      // 2. The requested memory is never greater than the block size;
+      //    allocArr() maps larger arrays on their own (getLargeMem()).
 
 
 
@@ -386,24 +558,27 @@ private:
 
       // If no match from recycle list.. .
       if (lis->_first == NULL) {
+         ++_numBlockAllocs;
          bool have_size  = _activeBlock->getMem(t,ret);
          if (!have_size) {
             if ( _activeBlock->getRemainSize() >= 40 ) {
                MemRecycleList<T>* remlis = getMemRecycleList(getArraySize(downtoSizeT(_activeBlock->getRemainSize())));
                T* temp = NULL;
                _activeBlock->getMem(downtoSizeT(_activeBlock->getRemainSize()),temp);
-               remlis->pushFront(temp);
+               ++_activeBlock->_nLive;
+               recycle(remlis, temp);
             }
             //remlis->pushFront((T*)_activeBlock->_ptr);
-            _activeBlock = new MemBlock<T>(_activeBlock,_blockSize);
+            _activeBlock = newBlock(_activeBlock,_blockSize);
             //#ifdef MEM_DEBUG
             //cout << "New MemBlock... " << _activeBlock << endl;
             //#endif // MEM_DEBUG
             _activeBlock->getMem(t,ret);
          }
+         ++_activeBlock->_nLive;
       }
       else
-         ret = lis->popFront();
+         ret = reuse(lis);
       // 4. Get the memory from _activeBlock
       // 5. If not enough, recycle the remained memory and print out ---
       //    Note: recycle to the as biggest array index as possible
@@ -419,17 +594,169 @@ private:
       //#endif // MEM_DEBUG
       return ret;
    }
-   // Get the currently allocated number of MemBlock's
-   size_t getNumBlocks() const {
-      size_t num=1;
-      MemBlock<T>* finding = _activeBlock;
-      while (finding->getNextBlock() != 0) {
-         num++;
-         finding = finding->getNextBlock();
+   // The magazine of the calling thread, attached to this MemMgr
+   // [Note] There is one magazine per thread for all the MemMgr<T>'s, as
+   //        MEM_MGR_INIT(T) makes only one.
+   MemMagazine<T>& magazine() {
+      static thread_local MemMagazine<T> m;
+      if (m._mgr != this) {
+         if (m._mgr) m._mgr->detach(m);
+         lock_guard<mutex> lock(_mutex);
+         m._mgr = this;
+         _mags.push_back(&m);
       }
-      // TODO
-      return num;
+      return m;
+   }
+   // Flush all of 'm' and forget it
+   void detach(MemMagazine<T>& m) {
+      lock_guard<mutex> lock(_mutex);
+      flush(m, m.size());
+      _mags.erase(find(_mags.begin(), _mags.end(), &m));
+      m._mgr = 0;
+   }
+   // Fill the empty 'm' with up to MEM_MAG_SIZE / 2 objects, the recycled
+   // ones first; a new MemBlock is only made for the first object, not to
+   // prefetch the rest. Return #objects in 'm'.
+   size_t refill(MemMagazine<T>& m) {
+      lock_guard<mutex> lock(_mutex);
+      MemRecycleList<T>* l = getMemRecycleList(0);
+      size_t n = 0, s = toSizeT(S);
+      for (; n < MEM_MAG_SIZE / 2 && l->_first; ++n)
+         m._objs[n] = reuse(l);
+      if (!n) m._objs[n++] = getMem(S);
+      for (; n < MEM_MAG_SIZE / 2 && _activeBlock->getRemainSize() >= s; ++n) {
+         _activeBlock->getMem(s, m._objs[n]);
+         ++_activeBlock->_nLive;
+         ++_numBlockAllocs;
+      }
+      m.setSize(n);
+      _bytesOut += n * s;
+      sampleUse();
+      return n;
+   }
+   // Recycle the 'k' oldest objects of 'm' (_mutex locked)
+   // Return #objects left in 'm'
+   size_t flush(MemMagazine<T>& m, size_t k) {
+      size_t n = m.size(), s = toSizeT(S);
+      MemRecycleList<T>* l = getMemRecycleList(0);
+      for (size_t i = 0; i < k; ++i) recycle(l, m._objs[i]);
+      copy(m._objs + k, m._objs + n, m._objs);
+      m.setSize(n - k);
+      _bytesOut -= k * s;
+      checkTrim();
+      return n - k;
+   }
+   // Keep the recycle lists through these two for the stats and _nLive
+   void recycle(MemRecycleList<T>* l, T* p) {
+      l->pushFront(p);
+      --blockOf(p)->_nLive;
+      ++_numRecycled;
+   }
+   T* reuse(MemRecycleList<T>* l) {
+      --_numRecycled;
+      ++_numRecycleHits;
+      T* p = l->popFront();
+      ++blockOf(p)->_nLive;
+      return p;
+   }
+   // (_mutex locked) 's' Bytes mapped for one array
+   T* getLargeMem(size_t s) {
+      void* p = mmap(0, s, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                     -1, 0);
+      if (p == MAP_FAILED) throw bad_alloc();
+      _largeArrs[(T*)p] = s;
+      _largeBytes += s;
+      sampleUse();
+      return (T*)p;
+   }
+   // (_mutex locked) Unmap 'p' if it is a large array; else return false
+   bool freeLargeMem(T* p) {
+      typename map<const T*, size_t>::iterator it = _largeArrs.find(p);
+      if (it == _largeArrs.end()) return false;
+      munmap(p, it->second);
+      _largeBytes -= it->second;
+      _largeArrs.erase(it);
+      return true;
    }
+   MemBlock<T>* newBlock(MemBlock<T>* n, size_t b) {
+      MemBlock<T>* blk = new MemBlock<T>(n, b);
+      _blocks[blk->_begin] = blk;
+      return blk;
+   }
+   void deleteBlock(MemBlock<T>* blk) {
+      _blocks.erase(blk->_begin);
+      delete blk;
+   }
+   // The MemBlock that 'p' was cut from, in O(log(#blocks)) time
+   MemBlock<T>* blockOf(const T* p) const {
+      typename map<const char*, MemBlock<T>*>::const_iterator it =
+         _blocks.upper_bound((const char*)p);
+      assert(it != _blocks.begin());
+      --it;
+      assert(it->second->contains(p));
+      return it->second;
+   }
+   // (_mutex locked) The free MemBlocks are unlinked and unmapped but the
+   // active one, which is rewound and released by madvise() instead. Their
+   // objects/arrays are taken off the recycle lists first, in one pass.
+   size_t trimBlocks() {
+      size_t nFree = 0;
+      for (MemBlock<T>* blk = _activeBlock; blk; blk = blk->_nextBlock)
+         if (!blk->_nLive && blk->_ptr != blk->_begin) ++nFree;
+      if (!nFree) return 0;
+      for (int i = 0; i < R_SIZE; ++i)
+         for (MemRecycleList<T>* ll = &_recycleList[i]; ll; ll = ll->_nextList)
+            _numRecycled -= ll->removeIf([this](const T* p) {
+               return blockOf(p)->_nLive == 0; });
+      size_t nBytes = 0;
+      for (MemBlock<T>** pb = &_activeBlock; *pb; ) {
+         MemBlock<T>* blk = *pb;
+         if (blk->_nLive || blk->_ptr == blk->_begin)
+            pb = &blk->_nextBlock;
+         else if (blk == _activeBlock) {
+            nBytes += blk->_ptr - blk->_begin;
+            blk->release();
+            pb = &blk->_nextBlock;
+         }
+         else {
+            nBytes += blk->getSize();
+            *pb = blk->_nextBlock;
+            deleteBlock(blk);
+         }
+      }
+      _bytesReleased += nBytes;
+      return nBytes;
+   }
+   // (_mutex locked) The high-water policy, after a free: trim once the
+   // free memory exceeds _trimAt, and then not before _highWater more Bytes
+   // are freed, lest a fragmented MemMgr scan its recycle lists on every
+   // free. See sampleUse() for the way back down.
+   void checkTrim() {
+      if (_highWater && freeBytes() > _trimAt) {
+         trimBlocks();
+         _trimAt = freeBytes() + _highWater;
+      }
+   }
+   // Bytes in the MemBlocks that are not out in a new, new[] or magazine
+   size_t freeBytes() const { return getNumBlocks() * _blockSize - _bytesOut; }
+   size_t numCached() const {
+      size_t n = 0;
+      for (size_t i = 0, nm = _mags.size(); i < nm; ++i) n += _mags[i]->size();
+      return n;
+   }
+   // (_mutex locked) After an allocation: the peak, and the threshold of
+   // the next automatic trim, back to _highWater above the free memory
+   void sampleUse() {
+      size_t s = toSizeT(S), b = _bytesOut - numCached() * s + _largeBytes;
+      if (b > _peakBytes) _peakBytes = b;
+      if (_highWater) _trimAt = min(_trimAt, freeBytes() + _highWater);
+   }
+   void resetStats() {
+      _numRecycled = _numRecycleHits = _numBlockAllocs = 0;
+      _bytesOut = _peakBytes = _bytesReleased = 0;
+   }
+   // Get the currently allocated number of MemBlock's
+   size_t getNumBlocks() const { return _blocks.size(); }
 
 };
 
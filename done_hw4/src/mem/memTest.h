@@ -9,8 +9,13 @@
 #define MEM_TEST_H
 
 #include <iostream>
+#include <iomanip>
 #include <vector>
 #include <cassert>
+#include <cstdlib>
+#include <thread>
+#include <atomic>
+#include <mutex>
 #include "memMgr.h"
 
 using namespace std;
@@ -52,6 +57,21 @@ public:
       MemTestObj::memReset(b);
       #endif // MEM_MGR_H
    }
+   // Give the free memory of the memory manager back to the OS; return
+   // #Bytes released
+   size_t trim() {
+      #ifdef MEM_MGR_H
+      return MemTestObj::memTrim();
+      #else
+      return 0;
+      #endif // MEM_MGR_H
+   }
+   // Trim automatically above 'b' free Bytes; 0 to turn it off
+   void setHighWater(size_t b) {
+      #ifdef MEM_MGR_H
+      MemTestObj::memHighWater(b);
+      #endif // MEM_MGR_H
+   }
    size_t getObjListSize() const { return _objList.size(); }
    size_t getArrListSize() const { return _arrList.size(); }
 
@@ -90,6 +110,24 @@ public:
       }
    }
 
+   // Run 'nThreads' threads of 'nOps' random operations each: new/delete
+   // of objects, and new[]/delete[] of small, R_SIZE-up and large arrays;
+   // thread #0 also trims now and then. The objects/arrays are tagged by
+   // their thread and checked before deleted; return #corrupted ones.
+   // With 'cross', an object is not deleted by the thread that newed it
+   // but handed to the next thread, so that the magazines get the objects
+   // of the other threads. The objects in _objList[]/_arrList[] are not
+   // touched.
+   size_t stress(size_t nThreads, size_t nOps, bool cross = false) {
+      StressShared sh(nThreads, cross);
+      vector<thread> threads;
+      for (size_t t = 0; t < nThreads; ++t)
+         threads.push_back(thread(stressThread, t, nOps, std::ref(sh)));
+      for (size_t t = 0; t < nThreads; ++t)
+         threads[t].join();
+      return sh._nBad;
+   }
+
    void print() const {
       #ifdef MEM_MGR_H
       MemTestObj::memPrint();
@@ -113,10 +151,167 @@ public:
       //size_t a = sizeof(MemTestObj);
       //cout << "_____" << a << "_____" << endl;
    }
+   void printStats() const {
+      #ifdef MEM_MGR_H
+      MemStats st = MemTestObj::memStats();
+      ios_base::fmtflags origFlags = cout.flags();
+      streamsize origPrec = cout.precision();
+      size_t nReq = st._numRecycleHits + st._numBlockAllocs;
+      cout << "=========================================" << endl
+           << "=        Memory Manager Statistics      =" << endl
+           << "=========================================" << endl
+           << "* Bytes in use          : " << st._bytesInUse << " (peak "
+           << st._peakBytesInUse << ")" << endl
+           << "* Number of blocks      : " << st._numBlocks << " ("
+           << st._blockSize << " Bytes each)" << endl
+           << "* Large arrays          : " << st._numLargeArrs << " ("
+           << st._largeBytes << " Bytes)" << endl
+           << "* Free objects/arrays   : " << st._numRecycled
+           << " recycled, " << st._numCached << " in magazines" << endl
+           << "* Recycle hit rate      : " << fixed << setprecision(2)
+           << (nReq? 100.0 * st._numRecycleHits / nReq: 0.0) << "% ("
+           << st._numRecycleHits << " hits, " << st._numBlockAllocs
+           << " misses)" << endl
+           << "* Released to the OS    : " << st._bytesReleased << " Bytes"
+           << endl;
+      cout.flags(origFlags);
+      cout.precision(origPrec);
+      #endif // MEM_MGR_H
+   }
 
 private:
    vector<MemTestObj*>   _objList;
    vector<MemTestObj*>   _arrList;
+
+   // The objects (and their tags) handed to a thread to delete
+   struct StressInbox {
+      mutex                 _mutex;
+      vector<MemTestObj*>   _objs;
+      vector<int>           _tags;
+   };
+   // The data shared by the threads of stress(); _inboxes[] is empty
+   // unless the objects are deleted by the other threads
+   struct StressShared {
+      StressShared(size_t n, bool cross)
+         : _nThreads(n), _inboxes(cross? n: 0), _nBad(0), _nRunning(n) {}
+      size_t                _nThreads;
+      vector<StressInbox>   _inboxes;
+      atomic<size_t>        _nBad;
+      atomic<size_t>        _nRunning;
+   };
+
+   static void tag(MemTestObj* o, int t) {
+      o->_dataSI = short(t);
+      for (int i = 0; i < 5; ++i) o->_dataI[i] = t;
+   }
+   static bool isTagged(const MemTestObj* o, int t) {
+      for (int i = 0; i < 5; ++i)
+         if (o->_dataI[i] != t) return false;
+      return o->_dataSI == short(t);
+   }
+   // Move the objects in objs[]/tags[] to the inbox of thread #to
+   static void handOff(StressShared& sh, size_t to, vector<MemTestObj*>& objs,
+                       vector<int>& tags) {
+      StressInbox& in = sh._inboxes[to];
+      lock_guard<mutex> lock(in._mutex);
+      in._objs.insert(in._objs.end(), objs.begin(), objs.end());
+      in._tags.insert(in._tags.end(), tags.begin(), tags.end());
+      objs.clear(); tags.clear();
+   }
+   // Check and delete the objects in the inbox of thread #id
+   static void drainInbox(StressShared& sh, size_t id) {
+      vector<MemTestObj*> objs;
+      vector<int> tags;
+      {
+         StressInbox& in = sh._inboxes[id];
+         lock_guard<mutex> lock(in._mutex);
+         objs.swap(in._objs); tags.swap(in._tags);
+      }
+      for (size_t j = 0; j < objs.size(); ++j) {
+         if (!isTagged(objs[j], tags[j])) ++sh._nBad;
+         delete objs[j];
+      }
+   }
+   // The live objects go up to 4096 and down to 64 in turn. In the cross
+   // mode, the objects to delete are handed to thread #id+1 in batches of
+   // 64, and the inbox of thread #id is drained as often; at the end, a
+   // thread waits for all the others to hand off their objects before it
+   // drains its inbox for the last time.
+   static void stressThread(size_t id, size_t nOps, StressShared& sh) {
+      atomic<size_t>& nBad = sh._nBad;
+      const bool cross = !sh._inboxes.empty();
+      const size_t next = (id + 1) % sh._nThreads;
+      vector<MemTestObj*> outObjs;
+      vector<int> outTags;
+      unsigned seed = unsigned(id) + 1;
+      size_t largeSize = 4096;
+      #ifdef MEM_MGR_H
+      largeSize = MemTestObj::memStats()._blockSize / sizeof(MemTestObj) + 1;
+      #endif // MEM_MGR_H
+      const size_t arrSizes[3] = { 1 + id % 8, R_SIZE + id, largeSize };
+      vector<MemTestObj*> objs, arrs;
+      vector<int> objTags, arrTags;
+      vector<size_t> arrSizesUsed;
+      for (size_t i = 0; i < nOps; ++i) {
+         int t = int(id << 24 | (i & 0xffffff));
+         size_t r = size_t(rand_r(&seed));
+         size_t cap = (i >> 13) & 1? 64: 4096;
+         if (objs.size() < cap && r % 3) {
+            MemTestObj* o = new MemTestObj;
+            tag(o, t);
+            objs.push_back(o); objTags.push_back(t);
+         }
+         else if (objs.size()) {
+            size_t j = (r >> 4) % objs.size();
+            if (cross) {
+               outObjs.push_back(objs[j]); outTags.push_back(objTags[j]);
+            }
+            else {
+               if (!isTagged(objs[j], objTags[j])) ++nBad;
+               delete objs[j];
+            }
+            objs[j] = objs.back(); objs.pop_back();
+            objTags[j] = objTags.back(); objTags.pop_back();
+         }
+         if (i % 256 == 0) {
+            if (arrs.size() == 4) {   // delete the oldest array
+               MemTestObj* a = arrs[0];
+               size_t s = arrSizesUsed[0];
+               if (!isTagged(&a[0], arrTags[0]) ||
+                   !isTagged(&a[s - 1], arrTags[0])) ++nBad;
+               delete [] a;
+               arrs.erase(arrs.begin()); arrTags.erase(arrTags.begin());
+               arrSizesUsed.erase(arrSizesUsed.begin());
+            }
+            size_t s = arrSizes[(i >> 8) % 3];
+            MemTestObj* a = new MemTestObj[s];
+            tag(&a[0], t); tag(&a[s - 1], t);
+            arrs.push_back(a); arrTags.push_back(t); arrSizesUsed.push_back(s);
+         }
+         if (cross && i % 64 == 63) {
+            handOff(sh, next, outObjs, outTags);
+            drainInbox(sh, id);
+         }
+         #ifdef MEM_MGR_H
+         if (id == 0 && i % 8192 == 4096) MemTestObj::memTrim();
+         #endif // MEM_MGR_H
+      }
+      if (cross) {
+         handOff(sh, next, objs, objTags);
+         handOff(sh, next, outObjs, outTags);
+         --sh._nRunning;
+         while (sh._nRunning) this_thread::yield();
+         drainInbox(sh, id);
+      }
+      for (size_t j = 0; j < objs.size(); ++j) {
+         if (!isTagged(objs[j], objTags[j])) ++nBad;
+         delete objs[j];
+      }
+      for (size_t j = 0; j < arrs.size(); ++j) {
+         if (!isTagged(&arrs[j][arrSizesUsed[j] - 1], arrTags[j])) ++nBad;
+         delete [] arrs[j];
+      }
+   }
 };
 
 #endif // MEM_TEST_H